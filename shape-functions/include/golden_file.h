@@ -0,0 +1,254 @@
+/******************************************************************************
+ * Copyright (C) Siarhei Uzunbajakau, 2023.
+ *
+ * This program is free software. You can use, modify, and redistribute it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 or (at your option) any later version.
+ * This program is distributed without any warranty.
+ *
+ * Refer to COPYING.LESSER for more details.
+ ******************************************************************************/
+
+#ifndef GoldenFile_H__
+#define GoldenFile_H__
+
+#include <deal.II/base/exceptions.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Tabulated values of all shape functions at a fixed set of points. The
+// values of the shape function (global DoF) i, at the point j, component c are
+// stored in values[(i * n_points + j) * n_components + c]. The coordinates of
+// the point j are stored in points[j * dim ... j * dim + dim - 1].
+struct GoldenData
+{
+  std::uint32_t dim          = 0;
+  std::uint32_t degree       = 0;
+  std::uint32_t orientation  = 0;
+  std::uint32_t n_dofs       = 0;
+  std::uint32_t n_points     = 0;
+  std::uint32_t n_components = 0;
+
+  std::vector<double> points;
+  std::vector<double> values;
+};
+
+// The binary layout of a golden file is: GoldenHeader, points, values. All
+// numbers are stored in the native byte order.
+struct GoldenHeader
+{
+  char          magic[8];
+  std::uint32_t dim;
+  std::uint32_t degree;
+  std::uint32_t orientation;
+  std::uint32_t n_dofs;
+  std::uint32_t n_points;
+  std::uint32_t n_components;
+};
+
+const char golden_magic[8] = "SFGOLD1";
+
+inline void
+write_golden_file(const std::string &fname, const GoldenData &data)
+{
+  GoldenHeader header;
+
+  std::memcpy(header.magic, golden_magic, sizeof(golden_magic));
+  header.dim          = data.dim;
+  header.degree       = data.degree;
+  header.orientation  = data.orientation;
+  header.n_dofs       = data.n_dofs;
+  header.n_points     = data.n_points;
+  header.n_components = data.n_components;
+
+  std::ofstream out(fname, std::ios::binary);
+  AssertThrow(out, dealii::ExcFileNotOpen(fname));
+
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(data.points.data()),
+            data.points.size() * sizeof(double));
+  out.write(reinterpret_cast<const char *>(data.values.data()),
+            data.values.size() * sizeof(double));
+
+  AssertThrow(out, dealii::ExcIO());
+}
+
+// Read-only memory map of a golden file. The file is validated on opening.
+class GoldenFile
+{
+public:
+  GoldenFile(const std::string &fname);
+  GoldenFile(const GoldenFile &) = delete;
+  GoldenFile &
+  operator=(const GoldenFile &) = delete;
+  ~GoldenFile();
+
+  const GoldenHeader &
+  header() const
+  {
+    return *reinterpret_cast<const GoldenHeader *>(data);
+  }
+
+  const double *
+  points() const
+  {
+    return reinterpret_cast<const double *>(data + sizeof(GoldenHeader));
+  }
+
+  const double *
+  values() const
+  {
+    return points() + header().n_points * header().dim;
+  }
+
+private:
+  int         fd   = -1;
+  std::size_t size = 0;
+  const char *data = nullptr;
+
+  // An empty object. Used by the constructor to hold the file while it is
+  // validated.
+  GoldenFile() = default;
+
+  void
+  release();
+};
+
+// The descriptor and the mapping are held by a local GoldenFile that
+// releases them if a check fails. They are moved into *this only after all
+// checks have passed.
+inline GoldenFile::GoldenFile(const std::string &fname)
+{
+  GoldenFile file;
+
+  file.fd = open(fname.c_str(), O_RDONLY);
+  AssertThrow(file.fd != -1, dealii::ExcFileNotOpen(fname));
+
+  struct stat st;
+  AssertThrow(fstat(file.fd, &st) == 0, dealii::ExcIO());
+  file.size = st.st_size;
+
+  AssertThrow(file.size >= sizeof(GoldenHeader),
+              dealii::ExcMessage("The file " + fname +
+                                 " is too short to be a golden file."));
+
+  void *ptr = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+  AssertThrow(ptr != MAP_FAILED, dealii::ExcIO());
+  file.data = static_cast<const char *>(ptr);
+
+  const GoldenHeader &h = file.header();
+
+  AssertThrow(std::memcmp(h.magic, golden_magic, sizeof(golden_magic)) == 0,
+              dealii::ExcMessage("The file " + fname +
+                                 " is not a golden file."));
+
+  const std::size_t n_doubles =
+    std::size_t(h.n_points) * h.dim +
+    std::size_t(h.n_dofs) * h.n_points * h.n_components;
+
+  AssertThrow(file.size == sizeof(GoldenHeader) + n_doubles * sizeof(double),
+              dealii::ExcMessage("The size of the file " + fname +
+                                 " does not match its header."));
+
+  std::swap(fd, file.fd);
+  std::swap(size, file.size);
+  std::swap(data, file.data);
+}
+
+inline GoldenFile::~GoldenFile()
+{
+  release();
+}
+
+inline void
+GoldenFile::release()
+{
+  if (data != nullptr)
+    munmap(const_cast<char *>(data), size);
+
+  if (fd != -1)
+    close(fd);
+
+  data = nullptr;
+  fd   = -1;
+}
+
+struct GoldenDiff
+{
+  bool         header_matches = true;
+  bool         layout_matches = true;
+  double       max_diff       = 0.0;
+  std::size_t  n_mismatches   = 0;
+
+  // The shape function (global DoF) and the point of the largest difference.
+  unsigned int worst_dof      = 0;
+  unsigned int worst_point    = 0;
+};
+
+// A value a is considered equal to the golden value b if
+// |a - b| <= atol + rtol * |b|. NaN values never compare equal, and max_diff
+// is NaN if any difference is NaN.
+inline GoldenDiff
+compare_golden(const GoldenFile &golden,
+               const GoldenData &data,
+               const double      atol,
+               const double      rtol)
+{
+  GoldenDiff diff;
+
+  const GoldenHeader &h = golden.header();
+
+  if (h.degree != data.degree || h.orientation != data.orientation)
+    {
+      diff.header_matches = false;
+      return diff;
+    }
+
+  if (h.dim != data.dim || h.n_dofs != data.n_dofs ||
+      h.n_points != data.n_points || h.n_components != data.n_components)
+    {
+      diff.layout_matches = false;
+      return diff;
+    }
+
+  for (std::size_t k = 0; k < data.points.size(); k++)
+    if (!(std::abs(data.points[k] - golden.points()[k]) <=
+          atol + rtol * std::abs(golden.points()[k])))
+      {
+        diff.layout_matches = false;
+        return diff;
+      }
+
+  const double *values = golden.values();
+
+  for (std::size_t k = 0; k < data.values.size(); k++)
+    {
+      const double d = std::abs(data.values[k] - values[k]);
+
+      if (!(d <= atol + rtol * std::abs(values[k])))
+        diff.n_mismatches++;
+
+      if (d > diff.max_diff || (std::isnan(d) && !std::isnan(diff.max_diff)))
+        {
+          diff.max_diff    = d;
+          diff.worst_dof   = k / (std::size_t(h.n_points) * h.n_components);
+          diff.worst_point = (k / h.n_components) % h.n_points;
+        }
+    }
+
+  return diff;
+}
+
+#endif
@@ -9,10 +9,15 @@
  * Refer to COPYING.LESSER for more details.
  ******************************************************************************/
 
+#include <deal.II/base/quadrature_lib.h>
+#include <deal.II/base/thread_management.h>
+
 #include <deal.II/dofs/dof_handler.h>
 #include <deal.II/dofs/dof_tools.h>
 
 #include <deal.II/fe/fe_nedelec.h>
+#include <deal.II/fe/fe_values.h>
+#include <deal.II/fe/mapping_q.h>
 
 #include <deal.II/grid/grid_generator.h>
 #include <deal.II/grid/grid_tools.h>
@@ -23,30 +28,101 @@
 #include <deal.II/numerics/matrix_tools.h>
 #include <deal.II/numerics/vector_tools.h>
 
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <string>
 
+#include "golden_file.h"
+
 using namespace dealii;
 
+// The largest jump of the tangential component of a shape function across a
+// shared face that is still considered to be a round-off error.
+const double tangential_jump_tolerance = 1e-10;
+
+// Absolute and relative tolerances used when comparing tabulated shape
+// functions against golden files.
+const double golden_atol = 1e-10;
+const double golden_rtol = 1e-8;
+
+// The degrees of the finite elements checked by default, the same range as in
+// the test-nedelec program.
+const unsigned int default_max_degree = 4;
+
+// The shape functions are tabulated at the points of QGauss<dim>(3) on every
+// cell of the mesh.
+const unsigned int n_sample_points_1d = 3;
+
+template <int dim>
+constexpr unsigned int
+n_combined_orientations()
+{
+  return (dim == 2) ? 4 : 8;
+}
+
+double
+tangential_norm(const Tensor<1, 2> &normal, const Tensor<1, 2> &u)
+{
+  return std::abs(normal[0] * u[1] - normal[1] * u[0]);
+}
+
+double
+tangential_norm(const Tensor<1, 3> &normal, const Tensor<1, 3> &u)
+{
+  return cross_product_3d(normal, u).norm();
+}
+
+struct ContinuityReport
+{
+  unsigned int orientation = 0;
+  unsigned int degree      = 0;
+  unsigned int n_dofs      = 0;
+  unsigned int n_faces     = 0;
+  double       max_jump    = 0.0;
+  unsigned int worst_dof   = numbers::invalid_unsigned_int;
+};
+
 template <int dim>
 class ShapeFunctions
 {
 public:
   ShapeFunctions();
+  ShapeFunctions(unsigned int degree, unsigned int orientation);
 
   void
   run();
 
+  ContinuityReport
+  check_continuity();
+
+  GoldenData
+  sample();
+
 private:
-  const unsigned int combined_face_orientation = FACEORIENTATION__;
+  const unsigned int combined_face_orientation;
+  const bool         verbose;
 
   void
   make_mesh();
-  
+
+  std::vector<unsigned int>
+  shared_faces(TriaActiveIterator<CellAccessor<dim, dim>> cell) const;
+
   void
   print_shared_face(TriaActiveIterator<CellAccessor<dim, dim>> cell);
-  
+
+  double
+  max_tangential_jump(
+    const typename DoFHandler<dim>::active_cell_iterator &cell,
+    const unsigned int                                    face,
+    unsigned int                                         &worst_dof) const;
+
   void
   setup_system();
   
@@ -55,17 +131,24 @@ private:
 
   Triangulation<dim> triangulation;
   FE_Nedelec<dim>    fe;
+  MappingQ<dim>      mapping;
   DoFHandler<dim>    dof_handler;
   SparsityPattern    sparsity_pattern;
   Vector<double>     solution;
 
+  const FEValuesExtractors::Vector VE;
+
   const std::string fname_vtk =
     (DIMENSION__ == 2) ? "Data/2D_shape_function" : "Data/3D_shape_function";
 };
 
 template <int dim>
 ShapeFunctions<dim>::ShapeFunctions()
-  : fe(FEDEGREE__)
+  : combined_face_orientation(FACEORIENTATION__)
+  , verbose(true)
+  , fe(FEDEGREE__)
+  , mapping(1)
+  , VE(0)
 {
   if (dim == 2)
     if (combined_face_orientation > 3)
@@ -87,6 +170,36 @@ FACEORIENTATION__ must be in the range 0...7.\n";
   run();
 }
 
+// This constructor is used by the continuity checker. It does not print
+// anything and does not call run(). The checker calls it for many
+// orientations and degrees concurrently, so the orientation is always valid.
+template <int dim>
+ShapeFunctions<dim>::ShapeFunctions(unsigned int degree,
+                                    unsigned int orientation)
+  : combined_face_orientation(orientation)
+  , verbose(false)
+  , fe(degree)
+  , mapping(1)
+  , VE(0)
+{
+  Assert(orientation < n_combined_orientations<dim>(),
+         ExcIndexRange(orientation, 0, n_combined_orientations<dim>()));
+}
+
+template <int dim>
+std::vector<unsigned int>
+ShapeFunctions<dim>::shared_faces(
+  TriaActiveIterator<CellAccessor<dim, dim>> cell) const
+{
+  std::vector<unsigned int> faces;
+
+  for (unsigned int f = 0; f < GeometryInfo<dim>::faces_per_cell; f++)
+    if (cell->neighbor_index(f) != -1)
+      faces.push_back(f);
+
+  return faces;
+}
+
 template <>
 void
 ShapeFunctions<2>::print_shared_face(
@@ -95,13 +208,12 @@ ShapeFunctions<2>::print_shared_face(
   std::cout << "Cell id = " << cell->id() << "-----------------------------"
             << std::endl;
 
-  for (unsigned int f = 0; f < 4; f++)
-    if (cell->neighbor_index(f) != -1)
-      {
-        std::cout << "The local index of the shared face: " << f << std::endl;
-        std::cout << "Shared face - orientation: " << cell->line_orientation(f)
-                  << std::endl;
-      }
+  for (unsigned int f : shared_faces(cell))
+    {
+      std::cout << "The local index of the shared face: " << f << std::endl;
+      std::cout << "Shared face - orientation: " << cell->line_orientation(f)
+                << std::endl;
+    }
 }
 
 template <>
@@ -111,9 +223,8 @@ ShapeFunctions<3>::print_shared_face(
 {
   unsigned int face = -1;
 
-  for (unsigned int f = 0; f < 6; f++)
-    if (cell->neighbor_index(f) != -1)
-      face = f;
+  for (unsigned int f : shared_faces(cell))
+    face = f;
 
   std::cout << "Cell id = " << cell->id() << ": " << std::endl;
 
@@ -139,8 +250,9 @@ ShapeFunctions<2>::make_mesh()
   GridGenerator::non_standard_orientation_mesh(triangulation,
                                                combined_face_orientation);
 
-  for (auto cell : triangulation.active_cell_iterators())
-    print_shared_face(cell);
+  if (verbose)
+    for (auto cell : triangulation.active_cell_iterators())
+      print_shared_face(cell);
 }
 
 
@@ -155,14 +267,16 @@ ShapeFunctions<3>::make_mesh()
   std::tie(face_orientation, face_rotation, face_flip) =
     dealii::internal::split_face_orientation(combined_face_orientation);
 
-  std::cout << "Orientation ask: " << face_flip << face_rotation
-            << face_orientation << std::endl;
+  if (verbose)
+    std::cout << "Orientation ask: " << face_flip << face_rotation
+              << face_orientation << std::endl;
 
   GridGenerator::non_standard_orientation_mesh(
     triangulation, face_orientation, face_flip, face_rotation, false);
 
-  for (auto cell : triangulation.active_cell_iterators())
-    print_shared_face(cell);
+  if (verbose)
+    for (auto cell : triangulation.active_cell_iterators())
+      print_shared_face(cell);
 }
 
 template <int dim>
@@ -226,10 +340,462 @@ ShapeFunctions<dim>::run()
     }
 }
 
+// Evaluates the tangential traces of all shape functions on both sides of the
+// face at the quadrature points of the face. The quadrature points are mapped
+// back to the reference cells of the cell and of its neighbor, so the values
+// on both sides are computed at the same physical points regardless of the
+// orientation of the face.
+template <int dim>
+double
+ShapeFunctions<dim>::max_tangential_jump(
+  const typename DoFHandler<dim>::active_cell_iterator &cell,
+  const unsigned int                                    face,
+  unsigned int                                         &worst_dof) const
+{
+  const auto neighbor = cell->neighbor(face);
+
+  FEFaceValues<dim> fe_face_values(mapping,
+                                   fe,
+                                   QGauss<dim - 1>(fe.degree + 1),
+                                   update_quadrature_points |
+                                     update_normal_vectors);
+  fe_face_values.reinit(cell, face);
+
+  std::vector<Point<dim>> points_cell;
+  std::vector<Point<dim>> points_neighbor;
+
+  for (const auto &p : fe_face_values.get_quadrature_points())
+    {
+      points_cell.push_back(mapping.transform_real_to_unit_cell(cell, p));
+      points_neighbor.push_back(
+        mapping.transform_real_to_unit_cell(neighbor, p));
+    }
+
+  FEValues<dim> fe_values_cell(mapping,
+                               fe,
+                               Quadrature<dim>(points_cell),
+                               update_values);
+  FEValues<dim> fe_values_neighbor(mapping,
+                                   fe,
+                                   Quadrature<dim>(points_neighbor),
+                                   update_values);
+  fe_values_cell.reinit(cell);
+  fe_values_neighbor.reinit(neighbor);
+
+  const unsigned int dofs_per_cell = fe.n_dofs_per_cell();
+
+  std::vector<types::global_dof_index> dofs_cell(dofs_per_cell);
+  std::vector<types::global_dof_index> dofs_neighbor(dofs_per_cell);
+
+  cell->get_dof_indices(dofs_cell);
+  neighbor->get_dof_indices(dofs_neighbor);
+
+  // Global DoF -> (local DoF on the cell, local DoF on the neighbor). A global
+  // DoF that lives on one cell only must have zero tangential trace on the
+  // shared face.
+  std::map<types::global_dof_index, std::pair<unsigned int, unsigned int>>
+    local_dofs;
+
+  for (unsigned int i = 0; i < dofs_per_cell; i++)
+    {
+      local_dofs.emplace(dofs_cell[i],
+                         std::make_pair(numbers::invalid_unsigned_int,
+                                        numbers::invalid_unsigned_int));
+      local_dofs.emplace(dofs_neighbor[i],
+                         std::make_pair(numbers::invalid_unsigned_int,
+                                        numbers::invalid_unsigned_int));
+    }
+
+  for (unsigned int i = 0; i < dofs_per_cell; i++)
+    {
+      local_dofs[dofs_cell[i]].first      = i;
+      local_dofs[dofs_neighbor[i]].second = i;
+    }
+
+  double max_jump = 0.0;
+
+  for (const unsigned int q : fe_face_values.quadrature_point_indices())
+    for (const auto &dof : local_dofs)
+      {
+        Tensor<1, dim> u_cell;
+        Tensor<1, dim> u_neighbor;
+
+        if (dof.second.first != numbers::invalid_unsigned_int)
+          u_cell = fe_values_cell[VE].value(dof.second.first, q);
+
+        if (dof.second.second != numbers::invalid_unsigned_int)
+          u_neighbor = fe_values_neighbor[VE].value(dof.second.second, q);
+
+        const double jump =
+          tangential_norm(fe_face_values.normal_vector(q), u_cell - u_neighbor);
+
+        if (jump > max_jump)
+          {
+            max_jump  = jump;
+            worst_dof = dof.first;
+          }
+      }
+
+  return max_jump;
+}
+
+template <int dim>
+ContinuityReport
+ShapeFunctions<dim>::check_continuity()
+{
+  make_mesh();
+
+  dof_handler.reinit(triangulation);
+  dof_handler.distribute_dofs(fe);
+
+  ContinuityReport report;
+
+  report.orientation = combined_face_orientation;
+  report.degree      = fe.degree - 1;
+  report.n_dofs      = dof_handler.n_dofs();
+
+  // Every shared face is visited once, from the cell with the smaller index.
+  for (const auto &cell : dof_handler.active_cell_iterators())
+    for (unsigned int f : shared_faces(cell))
+      if (cell->neighbor_index(f) > cell->index())
+        {
+          unsigned int worst_dof = numbers::invalid_unsigned_int;
+
+          const double jump = max_tangential_jump(cell, f, worst_dof);
+
+          report.n_faces++;
+          if (jump > report.max_jump)
+            {
+              report.max_jump  = jump;
+              report.worst_dof = worst_dof;
+            }
+        }
+
+  return report;
+}
+
+// Tabulates the values of all shape functions at the points of
+// QGauss<dim>(n_sample_points_1d) on every cell. A single FEValues object
+// evaluates all shape functions at all points of a cell at once, which is
+// much cheaper than building DataOut patches for every shape function.
+template <int dim>
+GoldenData
+ShapeFunctions<dim>::sample()
+{
+  make_mesh();
+
+  dof_handler.reinit(triangulation);
+  dof_handler.distribute_dofs(fe);
+
+  const QGauss<dim> quadrature(n_sample_points_1d);
+
+  FEValues<dim> fe_values(mapping,
+                          fe,
+                          quadrature,
+                          update_values | update_quadrature_points);
+
+  const unsigned int dofs_per_cell = fe.n_dofs_per_cell();
+  const unsigned int n_q_points    = quadrature.size();
+
+  GoldenData data;
+
+  data.dim          = dim;
+  data.degree       = fe.degree - 1;
+  data.orientation  = combined_face_orientation;
+  data.n_dofs       = dof_handler.n_dofs();
+  data.n_points     = triangulation.n_active_cells() * n_q_points;
+  data.n_components = dim;
+
+  data.points.reserve(data.n_points * dim);
+  data.values.assign(std::size_t(data.n_dofs) * data.n_points * dim, 0.0);
+
+  std::vector<types::global_dof_index> local_dof_indices(dofs_per_cell);
+
+  unsigned int point = 0;
+  for (const auto &cell : dof_handler.active_cell_iterators())
+    {
+      fe_values.reinit(cell);
+      cell->get_dof_indices(local_dof_indices);
+
+      for (const unsigned int q : fe_values.quadrature_point_indices())
+        {
+          for (unsigned int d = 0; d < dim; d++)
+            data.points.push_back(fe_values.quadrature_point(q)[d]);
+
+          for (const unsigned int i : fe_values.dof_indices())
+            {
+              const Tensor<1, dim> value = fe_values[VE].value(i, q);
+
+              for (unsigned int c = 0; c < dim; c++)
+                data.values[(std::size_t(local_dof_indices[i]) * data.n_points +
+                             point + q) *
+                              dim +
+                            c] = value[c];
+            }
+        }
+
+      point += n_q_points;
+    }
+
+  return data;
+}
+
+// Calls f for all combined orientations of the shared face and all degrees
+// 0...max_degree. Each orientation is processed by a separate task. The
+// returned reports are indexed as reports[orientation][degree].
+template <int dim, typename Report>
+std::vector<std::vector<Report>>
+sweep_orientations(const unsigned int                                  max_degree,
+                   const std::function<Report(ShapeFunctions<dim> &)> &f)
+{
+  const unsigned int n_orientations = n_combined_orientations<dim>();
+
+  std::vector<std::vector<Report>> reports(n_orientations);
+
+  Threads::TaskGroup<void> tasks;
+  for (unsigned int o = 0; o < n_orientations; o++)
+    tasks += Threads::new_task([&reports, &f, o, max_degree]() {
+      for (unsigned int p = 0; p <= max_degree; p++)
+        {
+          ShapeFunctions<dim> shape_functions(p, o);
+          reports[o].push_back(f(shape_functions));
+        }
+    });
+  tasks.join_all();
+
+  return reports;
+}
+
+// Checks the continuity of the tangential components of the shape functions
+// for all combined orientations of the shared face and all degrees
+// 0...max_degree. The orientations are checked in parallel. Nothing is saved
+// on disk. Returns the exit code of the program: 0 if all jumps are below
+// tangential_jump_tolerance and 1 otherwise.
+template <int dim>
+int
+check_continuity(const unsigned int max_degree)
+{
+  const auto reports = sweep_orientations<dim, ContinuityReport>(
+    max_degree, [](ShapeFunctions<dim> &shape_functions) {
+      return shape_functions.check_continuity();
+    });
+
+  std::cout << "Dimensions: " << dim << std::endl
+            << "Tolerance: " << tangential_jump_tolerance << std::endl
+            << std::endl
+            << "orientation  p  ndofs  nfaces   max jump  worst dof  result"
+            << std::endl;
+
+  bool passed = true;
+
+  for (const auto &reports_o : reports)
+    for (const auto &report : reports_o)
+      {
+        const bool ok = (report.max_jump < tangential_jump_tolerance);
+        passed        = passed && ok;
+
+        std::cout << std::setw(11) << report.orientation << std::setw(3)
+                  << report.degree << std::setw(7) << report.n_dofs
+                  << std::setw(8) << report.n_faces << std::setw(11)
+                  << std::scientific << std::setprecision(2)
+                  << report.max_jump << std::defaultfloat << std::setw(11)
+                  << ((report.worst_dof == numbers::invalid_unsigned_int) ?
+                        std::string("-") :
+                        std::to_string(report.worst_dof))
+                  << "  " << (ok ? "pass" : "FAIL") << std::endl;
+      }
+
+  std::cout << std::endl << (passed ? "PASSED" : "FAILED") << std::endl;
+
+  return passed ? 0 : 1;
+}
+
+struct GoldenReport
+{
+  unsigned int orientation = 0;
+  unsigned int degree      = 0;
+  unsigned int n_dofs      = 0;
+  unsigned int n_points    = 0;
+  bool         ok          = true;
+  GoldenDiff   diff;
+  std::string  message;
+};
+
+std::string
+golden_file_name(const std::string &dir,
+                 const unsigned int dim,
+                 const unsigned int degree,
+                 const unsigned int orientation)
+{
+  return dir + "/golden_" + std::to_string(dim) + "D_p" +
+         std::to_string(degree) + "_o" + std::to_string(orientation) + ".bin";
+}
+
+// Tabulates the shape functions for all combined orientations and all degrees
+// 0...max_degree and either writes one golden file per (dim, degree,
+// orientation) into dir or compares the tabulated values against the golden
+// files stored in dir. Returns the exit code of the program.
+template <int dim>
+int
+golden(const std::string &dir, const unsigned int max_degree, const bool write)
+{
+  const auto reports = sweep_orientations<dim, GoldenReport>(
+    max_degree, [&dir, write](ShapeFunctions<dim> &shape_functions) {
+      const GoldenData data = shape_functions.sample();
+
+      GoldenReport report;
+
+      report.orientation = data.orientation;
+      report.degree      = data.degree;
+      report.n_dofs      = data.n_dofs;
+      report.n_points    = data.n_points;
+
+      const std::string fname =
+        golden_file_name(dir, dim, data.degree, data.orientation);
+
+      try
+        {
+          if (write)
+            {
+              write_golden_file(fname, data);
+            }
+          else
+            {
+              const GoldenFile golden_file(fname);
+
+              report.diff =
+                compare_golden(golden_file, data, golden_atol, golden_rtol);
+
+              report.ok = report.diff.header_matches &&
+                          report.diff.layout_matches &&
+                          (report.diff.n_mismatches == 0);
+
+              if (!report.diff.header_matches)
+                report.message = "degree or orientation in the file differs";
+              else if (!report.diff.layout_matches)
+                report.message = "mesh or DoF layout differs";
+            }
+        }
+      catch (const std::exception &exc)
+        {
+          report.ok      = false;
+          report.message = fname + ": " + exc.what();
+        }
+
+      return report;
+    });
+
+  std::cout << "Dimensions: " << dim << std::endl
+            << "Golden files: " << dir << std::endl;
+
+  if (!write)
+    std::cout << "Tolerance: |a - b| <= " << golden_atol << " + "
+              << golden_rtol << " |b|" << std::endl
+              << std::endl
+              << "orientation  p  ndofs  npoints   max diff  worst dof  "
+              << "worst point  mismatches  result" << std::endl;
+
+  // The location of the largest difference, "-" if all values are equal.
+  auto worst = [](const GoldenReport &report, const unsigned int index) {
+    return (report.diff.max_diff > 0.0 || std::isnan(report.diff.max_diff)) ?
+             std::to_string(index) :
+             std::string("-");
+  };
+
+  bool passed = true;
+
+  for (const auto &reports_o : reports)
+    for (const auto &report : reports_o)
+      {
+        passed = passed && report.ok;
+
+        if (write)
+          {
+            if (!report.ok)
+              std::cout << report.message << std::endl;
+            continue;
+          }
+
+        std::cout << std::setw(11) << report.orientation << std::setw(3)
+                  << report.degree << std::setw(7) << report.n_dofs
+                  << std::setw(9) << report.n_points << std::setw(11)
+                  << std::scientific << std::setprecision(2)
+                  << report.diff.max_diff << std::defaultfloat
+                  << std::setw(11) << worst(report, report.diff.worst_dof)
+                  << std::setw(13) << worst(report, report.diff.worst_point)
+                  << std::setw(12) << report.diff.n_mismatches << "  "
+                  << (report.ok ? "pass" : "FAIL") << " " << report.message
+                  << std::endl;
+      }
+
+  if (write)
+    std::cout << (passed ? "Golden files are written." :
+                           "Failed to write golden files.")
+              << std::endl;
+  else
+    std::cout << std::endl << (passed ? "PASSED" : "FAILED") << std::endl;
+
+  return passed ? 0 : 1;
+}
+
+// Reads the maximum degree from argv[index]. If there is no such argument,
+// the maximum degree is default_max_degree. Returns false if the argument is
+// not a non-negative integer.
+bool
+parse_max_degree(int argc, char *argv[], const int index, unsigned int &degree)
+{
+  degree = default_max_degree;
+
+  if (argc <= index)
+    return true;
+
+  char      *end;
+  const long value = std::strtol(argv[index], &end, 10);
+
+  if (end == argv[index] || *end != '\0' || value < 0 ||
+      value > std::numeric_limits<int>::max())
+    {
+      std::cout << "Invalid max_degree: " << argv[index] << std::endl;
+      return false;
+    }
+
+  degree = value;
+  return true;
+}
+
 int
-main()
+main(int argc, char *argv[])
 {
-  ShapeFunctions<DIMENSION__> shape_functions;
+  const std::string mode = (argc > 1) ? argv[1] : "plot";
+
+  if (mode == "plot")
+    {
+      ShapeFunctions<DIMENSION__> shape_functions;
+      return 0;
+    }
+
+  if (mode == "check")
+    {
+      unsigned int max_degree;
+      if (!parse_max_degree(argc, argv, 2, max_degree))
+        return 1;
+
+      return check_continuity<DIMENSION__>(max_degree);
+    }
+
+  if (mode == "golden-write" || mode == "golden-compare")
+    {
+      const std::string dir = (argc > 2) ? argv[2] : "Data";
+      unsigned int max_degree;
+      if (!parse_max_degree(argc, argv, 3, max_degree))
+        return 1;
+
+      return golden<DIMENSION__>(dir, max_degree, mode == "golden-write");
+    }
+
+  std::cout << "Usage: shape-functions [plot | check [max_degree] |\n"
+            << "                        golden-write [dir [max_degree]] |\n"
+            << "                        golden-compare [dir [max_degree]]]\n";
 
-  return 0;
+  return 1;
 }
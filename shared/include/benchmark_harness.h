@@ -0,0 +1,885 @@
+/******************************************************************************
+ * Copyright (C) Siarhei Uzunbajakau, 2023.
+ *
+ * This program is free software. You can use, modify, and redistribute it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 or (at your option) any later version.
+ * This program is distributed without any warranty.
+ *
+ * Refer to COPYING.LESSER for more details.
+ ******************************************************************************/
+
+#ifndef BenchmarkHarness_H__
+#define BenchmarkHarness_H__
+
+#include <deal.II/base/exceptions.h>
+#include <deal.II/base/timer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "perf_counters.h"
+#include "section_timer.h"
+
+// Runs a function that contains TMR(...) sections a number of times and
+// collects statistics of the wall and CPU time of every section. The first
+// n_warmup runs are discarded. Each run gets a fresh TimerOutput, so the
+// samples of different runs are independent. Optionally, the hardware
+// counters of the calling thread (see perf_counters.h) are collected for
+// every section as well.
+//
+// Every TMR(...) section is also a SectionTimer scope (see section_timer.h),
+// so STMR(...) scopes nested in it show up as its children in the exported
+// Chrome trace and folded stacks. Unlike STMR(...), TMR(...) looks up its name
+// each time it is entered.
+//
+// Usage:
+//
+//   #define TMR(__name) BenchmarkHarness::Scope timer_section(timer, __name)
+//
+//   BenchmarkHarness harness(BenchmarkHarness::parse_command_line(argc, argv));
+//
+//   harness.run([](BenchmarkHarness::Timer &timer) {
+//     {TMR("Assemble"); assemble();}
+//     {TMR("Solve"); solve();}
+//   });
+//
+//   return harness.report(std::cout);
+class BenchmarkHarness
+{
+public:
+  struct Settings
+  {
+    unsigned int n_warmup      = 1;
+    unsigned int n_repetitions = 10;
+
+    // If not empty, the statistics are exported into these files.
+    std::string fname_csv;
+    std::string fname_json;
+
+    // If not empty, the median wall times are compared against the ones
+    // stored in this file. The file is a csv file written by a previous run.
+    std::string fname_baseline;
+
+    // A section regresses if its median wall time exceeds the baseline
+    // median wall time by more than this fraction.
+    double threshold = 0.1;
+
+    // Collect hardware counters for every section.
+    bool counters = false;
+
+    // If not empty, the nested sections of all runs are traced and exported
+    // into these files in the Chrome trace-event and folded-stack formats.
+    std::string fname_trace;
+    std::string fname_folded;
+  };
+
+  // The timer of a single run. Holds the TimerOutput of the run and the
+  // hardware counts accumulated by every section during the run.
+  class Timer
+  {
+  public:
+    Timer(const PerfCounters *perf_counters)
+      : timer_output(std::cout,
+                     dealii::TimerOutput::never,
+                     dealii::TimerOutput::cpu_and_wall_times)
+      , perf_counters(perf_counters)
+    {}
+
+    dealii::TimerOutput timer_output;
+
+    // Null if the counters are not collected.
+    const PerfCounters *const perf_counters;
+
+    std::map<std::string, PerfCounters::Values> counts;
+  };
+
+  // Times a section with TimerOutput::Scope and, if enabled, reads the
+  // hardware counters when the section is entered and left.
+  class Scope
+  {
+  public:
+    Scope(Timer &timer, const std::string &name)
+      : timer(timer)
+      , name(name)
+      , timer_output_scope(timer.timer_output, name)
+      , section_scope(SectionTimer::section_id(name))
+    {
+      if (timer.perf_counters != nullptr)
+        start = timer.perf_counters->read();
+    }
+
+    ~Scope()
+    {
+      if (timer.perf_counters == nullptr)
+        return;
+
+      const PerfCounters::Values delta =
+        PerfCounters::difference(start, timer.perf_counters->read());
+
+      auto it = timer.counts.find(name);
+      if (it == timer.counts.end())
+        {
+          PerfCounters::Values zero;
+          zero.fill(0);
+          it = timer.counts.emplace(name, zero).first;
+        }
+
+      for (unsigned int e = 0; e < PerfCounters::n_events; e++)
+        it->second[e] += delta[e];
+    }
+
+  private:
+    Timer                      &timer;
+    const std::string           name;
+    dealii::TimerOutput::Scope  timer_output_scope;
+    SectionTimer::Scope         section_scope;
+    PerfCounters::Reading       start;
+  };
+
+  struct Statistics
+  {
+    double min    = 0.0;
+    double median = 0.0;
+    double p95    = 0.0;
+    double mean   = 0.0;
+    double stddev = 0.0;
+  };
+
+  BenchmarkHarness() = delete;
+  BenchmarkHarness(const Settings &settings);
+
+  // Recognizes the options --warmup N, --repeat N, --csv FILE, --json FILE,
+  // --baseline FILE, --threshold X, --counters 0|1, --trace FILE,
+  // --folded FILE.
+  static Settings
+  parse_command_line(int argc, char *argv[]);
+
+  void
+  run(const std::function<void(Timer &)> &f);
+
+  // Declares that the section does the given amount of work, e.g. 1024
+  // "cells" or 5e6 "nonzeros", in every run. The summary then reports the
+  // throughput of the section, i.e. the amount divided by the median wall
+  // time.
+  void
+  set_work(const std::string &section,
+           const double       amount,
+           const std::string &unit)
+  {
+    work[section] = std::make_pair(amount, unit);
+  }
+
+  // Prints the summary, exports the statistics and compares them against
+  // the baseline as requested by the settings. Returns 1 if any section
+  // regressed and 0 otherwise. Can be used as the exit code of a program.
+  int
+  report(std::ostream &out) const;
+
+  // The tables are formatted into a local stream, so the precision and the
+  // flags of out are left unchanged. The same holds for report() and
+  // compare_with_baseline().
+  void
+  print_summary(std::ostream &out) const;
+
+  void
+  write_csv(const std::string &fname) const;
+
+  void
+  write_json(const std::string &fname) const;
+
+  // Returns the number of sections that regressed.
+  int
+  compare_with_baseline(const std::string &fname, std::ostream &out) const;
+
+  static Statistics
+  compute_statistics(std::vector<double> samples);
+
+private:
+  const Settings settings;
+
+  // Quotes a field of a csv file as in RFC 4180: the field is enclosed in
+  // double quotes and the double quotes in it are doubled.
+  static std::string
+  csv_quote(const std::string &str);
+
+  // Splits a line of a csv file into fields. Undoes csv_quote().
+  static std::vector<std::string>
+  csv_split(const std::string &line);
+
+  // Parse the value of a command line option. Throw ExcMessage naming the
+  // option if the value is not an integer in [min, max] or not a finite
+  // number, respectively.
+  static unsigned int
+  parse_integer(const std::string &option,
+                const std::string &value,
+                const unsigned int min,
+                const unsigned int max);
+
+  static double
+  parse_number(const std::string &option, const std::string &value);
+
+  std::unique_ptr<PerfCounters> perf_counters;
+
+  std::map<std::string, std::vector<double>> wall_samples;
+  std::map<std::string, std::vector<double>> cpu_samples;
+
+  // The hardware counts of every section, one sample per run.
+  std::map<std::string, std::vector<PerfCounters::Values>> counter_samples;
+
+  // The amount of work done by a section in a run and its unit.
+  std::map<std::string, std::pair<double, std::string>> work;
+
+  // The amount of work per second of wall time. Zero if the work of the
+  // section is not set.
+  double
+  throughput(const std::string &section) const;
+
+  bool
+  counters_available() const
+  {
+    return perf_counters && perf_counters->is_available();
+  }
+
+  // The median over the runs of every counter and of the IPC.
+  std::map<std::string, double>
+  counter_medians(const std::string &section) const;
+
+  void
+  print_table(std::ostream                                     &out,
+              const std::string                                &title,
+              const std::map<std::string, std::vector<double>> &samples) const;
+
+  void
+  print_counters_table(std::ostream &out) const;
+
+  void
+  print_throughput_table(std::ostream &out) const;
+};
+
+inline BenchmarkHarness::BenchmarkHarness(const Settings &settings)
+  : settings(settings)
+{
+  if (settings.counters)
+    perf_counters = std::make_unique<PerfCounters>();
+
+  if (!settings.fname_trace.empty() || !settings.fname_folded.empty())
+    SectionTimer::enable_tracing();
+}
+
+inline std::string
+BenchmarkHarness::csv_quote(const std::string &str)
+{
+  std::string quoted = "\"";
+  for (const char c : str)
+    {
+      if (c == '"')
+        quoted += '"';
+      quoted += c;
+    }
+  return quoted + "\"";
+}
+
+inline std::vector<std::string>
+BenchmarkHarness::csv_split(const std::string &line)
+{
+  std::vector<std::string> fields(1);
+  bool                     quoted = false;
+
+  for (std::size_t i = 0; i < line.size(); i++)
+    {
+      const char c = line[i];
+
+      if (quoted)
+        {
+          if (c != '"')
+            fields.back() += c;
+          else if (i + 1 < line.size() && line[i + 1] == '"')
+            fields.back() += line[++i];
+          else
+            quoted = false;
+        }
+      else if (c == '"')
+        quoted = true;
+      else if (c == ',')
+        fields.emplace_back();
+      else
+        fields.back() += c;
+    }
+
+  return fields;
+}
+
+inline unsigned int
+BenchmarkHarness::parse_integer(const std::string &option,
+                                const std::string &value,
+                                const unsigned int min,
+                                const unsigned int max)
+{
+  char      *end;
+  const long n = std::strtol(value.c_str(), &end, 10);
+
+  AssertThrow(!value.empty() && *end == '\0' && n >= long(min) &&
+                n <= long(max),
+              dealii::ExcMessage("The value of the option " + option +
+                                 " must be an integer in [" +
+                                 std::to_string(min) + ", " +
+                                 std::to_string(max) + "], not " + value +
+                                 "."));
+
+  return n;
+}
+
+inline double
+BenchmarkHarness::parse_number(const std::string &option,
+                               const std::string &value)
+{
+  char        *end;
+  const double x = std::strtod(value.c_str(), &end);
+
+  AssertThrow(!value.empty() && *end == '\0' && std::isfinite(x),
+              dealii::ExcMessage("The value of the option " + option +
+                                 " must be a number, not " + value + "."));
+
+  return x;
+}
+
+inline BenchmarkHarness::Settings
+BenchmarkHarness::parse_command_line(int argc, char *argv[])
+{
+  const unsigned int max_runs = std::numeric_limits<int>::max();
+
+  Settings settings;
+
+  for (int i = 1; i < argc; i++)
+    {
+      const std::string option = argv[i];
+
+      AssertThrow(i + 1 < argc,
+                  dealii::ExcMessage("The option " + option +
+                                     " requires a value."));
+
+      const std::string value = argv[++i];
+
+      if (option == "--warmup")
+        settings.n_warmup = parse_integer(option, value, 0, max_runs);
+      else if (option == "--repeat")
+        settings.n_repetitions = parse_integer(option, value, 1, max_runs);
+      else if (option == "--csv")
+        settings.fname_csv = value;
+      else if (option == "--json")
+        settings.fname_json = value;
+      else if (option == "--baseline")
+        settings.fname_baseline = value;
+      else if (option == "--threshold")
+        settings.threshold = parse_number(option, value);
+      else if (option == "--counters")
+        settings.counters = (parse_integer(option, value, 0, 1) != 0);
+      else if (option == "--trace")
+        settings.fname_trace = value;
+      else if (option == "--folded")
+        settings.fname_folded = value;
+      else
+        AssertThrow(false,
+                    dealii::ExcMessage(
+                      "Unknown option " + option +
+                      ". Valid options: --warmup N, --repeat N, --csv FILE, "
+                      "--json FILE, --baseline FILE, --threshold X, "
+                      "--counters 0|1, --trace FILE, --folded FILE."));
+    }
+
+  return settings;
+}
+
+inline void
+BenchmarkHarness::run(const std::function<void(Timer &)> &f)
+{
+  for (unsigned int i = 0; i < settings.n_warmup + settings.n_repetitions; i++)
+    {
+      Timer timer(counters_available() ? perf_counters.get() : nullptr);
+
+      f(timer);
+
+      if (i < settings.n_warmup)
+        continue;
+
+      for (const auto &s : timer.timer_output.get_summary_data(
+             dealii::TimerOutput::total_wall_time))
+        wall_samples[s.first].push_back(s.second);
+
+      for (const auto &s : timer.timer_output.get_summary_data(
+             dealii::TimerOutput::total_cpu_time))
+        cpu_samples[s.first].push_back(s.second);
+
+      for (const auto &s : timer.counts)
+        counter_samples[s.first].push_back(s.second);
+    }
+}
+
+inline double
+BenchmarkHarness::throughput(const std::string &section) const
+{
+  const auto w = work.find(section);
+  const auto s = wall_samples.find(section);
+
+  if (w == work.end() || s == wall_samples.end())
+    return 0.0;
+
+  const double median = compute_statistics(s->second).median;
+
+  return (median > 0.0) ? w->second.first / median : 0.0;
+}
+
+inline std::map<std::string, double>
+BenchmarkHarness::counter_medians(const std::string &section) const
+{
+  std::map<std::string, double> medians;
+
+  const auto it = counter_samples.find(section);
+  if (it == counter_samples.end())
+    return medians;
+
+  for (unsigned int e = 0; e < PerfCounters::n_events; e++)
+    {
+      if (!perf_counters->is_available(PerfCounters::Event(e)))
+        continue;
+
+      std::vector<double> samples;
+      for (const auto &values : it->second)
+        samples.push_back(values[e]);
+
+      medians[PerfCounters::get_name(PerfCounters::Event(e))] =
+        compute_statistics(samples).median;
+    }
+
+  if (perf_counters->is_available(PerfCounters::instructions))
+    {
+      std::vector<double> samples;
+      for (const auto &values : it->second)
+        if (values[PerfCounters::cycles] > 0)
+          samples.push_back(double(values[PerfCounters::instructions]) /
+                            values[PerfCounters::cycles]);
+
+      medians["ipc"] = compute_statistics(samples).median;
+    }
+
+  return medians;
+}
+
+// The percentile is computed by linear interpolation between the closest
+// ranks. The standard deviation is the sample standard deviation.
+inline BenchmarkHarness::Statistics
+BenchmarkHarness::compute_statistics(std::vector<double> samples)
+{
+  Statistics stat;
+
+  if (samples.empty())
+    return stat;
+
+  std::sort(samples.begin(), samples.end());
+
+  const std::size_t n = samples.size();
+
+  auto percentile = [&samples, n](const double p) {
+    const double      rank = p * (n - 1);
+    const std::size_t lo   = static_cast<std::size_t>(std::floor(rank));
+    const std::size_t hi   = std::min(lo + 1, n - 1);
+
+    return samples[lo] + (rank - lo) * (samples[hi] - samples[lo]);
+  };
+
+  stat.min    = samples.front();
+  stat.median = percentile(0.5);
+  stat.p95    = percentile(0.95);
+
+  for (const double s : samples)
+    stat.mean += s;
+  stat.mean /= n;
+
+  if (n > 1)
+    {
+      for (const double s : samples)
+        stat.stddev += (s - stat.mean) * (s - stat.mean);
+      stat.stddev = std::sqrt(stat.stddev / (n - 1));
+    }
+
+  return stat;
+}
+
+inline void
+BenchmarkHarness::print_table(
+  std::ostream                                     &os,
+  const std::string                                &title,
+  const std::map<std::string, std::vector<double>> &samples) const
+{
+  std::ostringstream out;
+
+  const std::string line = "+---------------------------------+-----------"
+                           "+------------+------------+------------"
+                           "+------------+\n";
+
+  out << line << "| " << std::left << std::setw(32) << title << "| no. runs  "
+      << "|    min     |   median   |    p95     |   stddev   |\n"
+      << std::right << line;
+
+  for (const auto &s : samples)
+    {
+      const Statistics stat = compute_statistics(s.second);
+
+      out << "| " << std::left << std::setw(32) << s.first.substr(0, 31)
+          << std::right << "| " << std::setw(9) << s.second.size() << " ";
+
+      for (const double t : {stat.min, stat.median, stat.p95, stat.stddev})
+        out << "| " << std::setw(9) << std::setprecision(3) << t << "s ";
+
+      out << "|\n";
+    }
+
+  out << line;
+
+  os << out.str();
+}
+
+inline void
+BenchmarkHarness::print_counters_table(std::ostream &os) const
+{
+  std::ostringstream out;
+
+  const std::string line = "+---------------------------------+------------"
+                           "+------------+--------+------------"
+                           "+---------------+\n";
+
+  out << line << "| " << std::left << std::setw(32)
+      << "Section (counters, median)" << std::right
+      << "|   cycles   |   instr.   |  IPC   | LLC misses "
+      << "| branch misses |\n"
+      << line;
+
+  auto column = [&out](const std::map<std::string, double> &medians,
+                       const std::string                   &name,
+                       const int                            width) {
+    const auto it = medians.find(name);
+
+    out << "| " << std::setw(width);
+    if (it == medians.end())
+      out << "n/a";
+    else if (name == "ipc")
+      out << std::fixed << std::setprecision(2) << it->second
+          << std::defaultfloat;
+    else
+      out << std::setprecision(4) << it->second;
+    out << " ";
+  };
+
+  for (const auto &s : wall_samples)
+    {
+      const std::map<std::string, double> medians = counter_medians(s.first);
+
+      out << "| " << std::left << std::setw(32) << s.first.substr(0, 31)
+          << std::right;
+      column(medians, "cycles", 10);
+      column(medians, "instructions", 10);
+      column(medians, "ipc", 6);
+      column(medians, "llc_misses", 10);
+      column(medians, "branch_misses", 13);
+      out << "|\n";
+    }
+
+  out << line;
+
+  os << out.str();
+}
+
+inline void
+BenchmarkHarness::print_throughput_table(std::ostream &os) const
+{
+  std::ostringstream out;
+
+  const std::string line = "+---------------------------------+------------"
+                           "+------------+-----------------+\n";
+
+  out << line << "| " << std::left << std::setw(32)
+      << "Section (throughput, median)" << std::right
+      << "| work / run |    unit    |  throughput, /s |\n"
+      << line;
+
+  for (const auto &s : wall_samples)
+    {
+      const auto w = work.find(s.first);
+      if (w == work.end())
+        continue;
+
+      out << "| " << std::left << std::setw(32) << s.first.substr(0, 31)
+          << std::right << "| " << std::setw(10) << std::setprecision(4)
+          << w->second.first << " | " << std::setw(10)
+          << w->second.second.substr(0, 10) << " | " << std::setw(15)
+          << std::setprecision(4) << throughput(s.first) << " |\n";
+    }
+
+  out << line;
+
+  os << out.str();
+}
+
+inline void
+BenchmarkHarness::print_summary(std::ostream &out) const
+{
+  out << "\nWarmup runs: " << settings.n_warmup
+      << ", measured runs: " << settings.n_repetitions << "\n\n";
+
+  print_table(out, "Section (wall time)", wall_samples);
+  out << "\n";
+  print_table(out, "Section (CPU time)", cpu_samples);
+  out << "\n";
+
+  if (counters_available())
+    {
+      print_counters_table(out);
+      out << "\n";
+    }
+
+  if (!work.empty())
+    {
+      print_throughput_table(out);
+      out << "\n";
+    }
+
+  if (perf_counters && !perf_counters->get_notice().empty())
+    out << perf_counters->get_notice() << "\n\n";
+}
+
+inline void
+BenchmarkHarness::write_csv(const std::string &fname) const
+{
+  std::ofstream out(fname);
+  AssertThrow(out, dealii::ExcFileNotOpen(fname));
+
+  const std::vector<std::string> counter_columns = {
+    "cycles", "instructions", "ipc", "llc_misses", "branch_misses"};
+
+  out << "section,runs,wall_min,wall_median,wall_p95,wall_mean,wall_stddev,"
+      << "cpu_min,cpu_median,cpu_p95,cpu_mean,cpu_stddev";
+
+  // The counter columns are left empty if the counters are not available.
+  if (perf_counters)
+    for (const auto &c : counter_columns)
+      out << "," << c << "_median";
+
+  // The throughput columns are left empty if the work is not set.
+  out << ",work,unit,throughput\n";
+
+  out << std::setprecision(9);
+
+  for (const auto &s : wall_samples)
+    {
+      const Statistics wall = compute_statistics(s.second);
+      const Statistics cpu  = compute_statistics(cpu_samples.at(s.first));
+
+      out << csv_quote(s.first) << "," << s.second.size();
+
+      for (const Statistics &stat : {wall, cpu})
+        out << "," << stat.min << "," << stat.median << "," << stat.p95 << ","
+            << stat.mean << "," << stat.stddev;
+
+      if (perf_counters)
+        {
+          const std::map<std::string, double> medians =
+            counter_medians(s.first);
+
+          for (const auto &c : counter_columns)
+            {
+              out << ",";
+              if (medians.count(c) > 0)
+                out << medians.at(c);
+            }
+        }
+
+      const auto w = work.find(s.first);
+      if (w != work.end())
+        out << "," << w->second.first << "," << csv_quote(w->second.second)
+            << "," << throughput(s.first);
+      else
+        out << ",,,";
+
+      out << "\n";
+    }
+}
+
+inline void
+BenchmarkHarness::write_json(const std::string &fname) const
+{
+  std::ofstream out(fname);
+  AssertThrow(out, dealii::ExcFileNotOpen(fname));
+
+  auto write_statistics = [&out](const Statistics &stat) {
+    out << "{\"min\": " << stat.min << ", \"median\": " << stat.median
+        << ", \"p95\": " << stat.p95 << ", \"mean\": " << stat.mean
+        << ", \"stddev\": " << stat.stddev << "}";
+  };
+
+  out << std::setprecision(9);
+
+  out << "{\n  \"warmup\": " << settings.n_warmup
+      << ",\n  \"repetitions\": " << settings.n_repetitions
+      << ",\n  \"sections\": [";
+
+  bool first = true;
+  for (const auto &s : wall_samples)
+    {
+      out << (first ? "\n" : ",\n") << "    {\"name\": \""
+          << SectionTimer::escape_json(s.first)
+          << "\", \"runs\": " << s.second.size() << ",\n     \"wall\": ";
+      write_statistics(compute_statistics(s.second));
+      out << ",\n     \"cpu\": ";
+      write_statistics(compute_statistics(cpu_samples.at(s.first)));
+
+      if (counters_available())
+        {
+          out << ",\n     \"counters\": {";
+
+          bool first_counter = true;
+          for (const auto &m : counter_medians(s.first))
+            {
+              out << (first_counter ? "" : ", ") << "\"" << m.first
+                  << "\": " << m.second;
+              first_counter = false;
+            }
+
+          out << "}";
+        }
+
+      const auto w = work.find(s.first);
+      if (w != work.end())
+        out << ",\n     \"work\": " << w->second.first << ", \"unit\": \""
+            << SectionTimer::escape_json(w->second.second)
+            << "\", \"throughput\": " << throughput(s.first);
+
+      out << "}";
+
+      first = false;
+    }
+
+  out << "\n  ]\n}\n";
+}
+
+inline int
+BenchmarkHarness::compare_with_baseline(const std::string &fname,
+                                        std::ostream      &os) const
+{
+  std::ifstream in(fname);
+  AssertThrow(in, dealii::ExcFileNotOpen(fname));
+
+  std::string line;
+  std::getline(in, line);
+
+  // Find the column of the median wall time in the header.
+  const std::vector<std::string> header = csv_split(line);
+
+  const auto column = std::find(header.begin(), header.end(), "wall_median");
+  AssertThrow(column != header.end(),
+              dealii::ExcMessage("The baseline file " + fname +
+                                 " has no wall_median column."));
+  const std::size_t median_column = column - header.begin();
+
+  std::map<std::string, double> baseline;
+
+  while (std::getline(in, line))
+    {
+      if (line.empty())
+        continue;
+
+      const std::vector<std::string> fields = csv_split(line);
+
+      AssertThrow(median_column < fields.size(),
+                  dealii::ExcMessage("Malformed line in " + fname + ": " +
+                                     line));
+
+      baseline[fields[0]] = std::stod(fields[median_column]);
+    }
+
+  std::ostringstream out;
+
+  out << "Comparison against the baseline " << fname
+      << " (threshold: " << 100.0 * settings.threshold << "%)\n";
+
+  int n_regressions = 0;
+
+  for (const auto &s : wall_samples)
+    {
+      const auto b = baseline.find(s.first);
+
+      out << "  " << std::left << std::setw(32) << s.first << std::right;
+
+      if (b == baseline.end())
+        {
+          out << "not in the baseline\n";
+          continue;
+        }
+
+      const double median = compute_statistics(s.second).median;
+      const double change = (b->second > 0.0) ? median / b->second - 1.0 : 0.0;
+      const bool   regressed = change > settings.threshold;
+
+      out << std::setw(10) << std::setprecision(3) << b->second << "s -> "
+          << std::setw(10) << median << "s " << std::showpos << std::fixed
+          << std::setprecision(1) << std::setw(7) << 100.0 * change << "%"
+          << std::noshowpos << std::defaultfloat
+          << (regressed ? "  REGRESSION" : "") << "\n";
+
+      if (regressed)
+        n_regressions++;
+    }
+
+  os << out.str();
+
+  return n_regressions;
+}
+
+inline int
+BenchmarkHarness::report(std::ostream &out) const
+{
+  print_summary(out);
+
+  if (!settings.fname_csv.empty())
+    write_csv(settings.fname_csv);
+
+  if (!settings.fname_json.empty())
+    write_json(settings.fname_json);
+
+  if (!settings.fname_trace.empty())
+    {
+      std::ofstream ofs(settings.fname_trace);
+      AssertThrow(ofs, dealii::ExcFileNotOpen(settings.fname_trace));
+      SectionTimer::write_chrome_trace(ofs);
+    }
+
+  if (!settings.fname_folded.empty())
+    {
+      std::ofstream ofs(settings.fname_folded);
+      AssertThrow(ofs, dealii::ExcFileNotOpen(settings.fname_folded));
+      SectionTimer::write_folded_stacks(ofs);
+    }
+
+  if (settings.fname_baseline.empty())
+    return 0;
+
+  const int n_regressions =
+    compare_with_baseline(settings.fname_baseline, out);
+
+  out << "Sections that regressed: " << n_regressions << "\n";
+
+  return (n_regressions > 0) ? 1 : 0;
+}
+
+#endif
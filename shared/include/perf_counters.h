@@ -0,0 +1,242 @@
+/******************************************************************************
+ * Copyright (C) Siarhei Uzunbajakau, 2023.
+ *
+ * This program is free software. You can use, modify, and redistribute it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 or (at your option) any later version.
+ * This program is distributed without any warranty.
+ *
+ * Refer to COPYING.LESSER for more details.
+ ******************************************************************************/
+
+#ifndef PerfCounters_H__
+#define PerfCounters_H__
+
+// Hardware performance counters of the calling thread read through
+// perf_event_open(2) on Linux. The counters are opened as one group, so they
+// are always scheduled on the PMU together and their ratios (e.g. IPC) are
+// consistent. If the counters can not be opened (not Linux, a container
+// without access to the PMU, kernel.perf_event_paranoid > 2, etc.), the object
+// is still usable: is_available() returns false and get_notice() explains why.
+//
+// Only the thread that created the object is counted. Work done by other
+// threads (e.g. TBB tasks) is not included.
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+
+#  include <unistd.h>
+#endif
+
+class PerfCounters
+{
+public:
+  enum Event
+  {
+    cycles,
+    instructions,
+    llc_misses,
+    branch_misses,
+    n_events
+  };
+
+  using Values = std::array<std::uint64_t, n_events>;
+
+  // The raw counts accumulated since the counters were opened together with
+  // the times the group was enabled and actually running on the PMU. The
+  // times differ if the kernel had to multiplex the PMU.
+  struct Reading
+  {
+    Values        counts;
+    std::uint64_t time_enabled = 0;
+    std::uint64_t time_running = 0;
+  };
+
+  PerfCounters();
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &
+  operator=(const PerfCounters &) = delete;
+  ~PerfCounters();
+
+  // True if at least the cycle counter is available.
+  bool
+  is_available() const
+  {
+    return available[cycles];
+  }
+
+  bool
+  is_available(const Event event) const
+  {
+    return available[event];
+  }
+
+  const std::string &
+  get_notice() const
+  {
+    return notice;
+  }
+
+  static const char *
+  get_name(const Event event)
+  {
+    static const char *names[n_events] = {"cycles",
+                                          "instructions",
+                                          "llc_misses",
+                                          "branch_misses"};
+    return names[event];
+  }
+
+  // Unavailable events read as zero.
+  Reading
+  read() const;
+
+  // The counts between two readings. If the PMU was multiplexed in between,
+  // the raw difference is scaled by the ratio of the enabled and running
+  // time differences. The result is never negative.
+  static Values
+  difference(const Reading &start, const Reading &end);
+
+private:
+  std::array<int, n_events>  fd;
+  std::array<bool, n_events> available;
+
+  // The position of every available event in the group read buffer.
+  std::array<unsigned int, n_events> position;
+  unsigned int                       n_open = 0;
+
+  std::string notice;
+};
+
+inline PerfCounters::PerfCounters()
+{
+  fd.fill(-1);
+  available.fill(false);
+  position.fill(0);
+
+#ifdef __linux__
+  const std::array<std::pair<std::uint32_t, std::uint64_t>, n_events> config =
+    {{{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}}};
+
+  for (unsigned int e = 0; e < n_events; e++)
+    {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+
+      attr.size           = sizeof(attr);
+      attr.type           = config[e].first;
+      attr.config         = config[e].second;
+      attr.disabled       = (e == cycles) ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_GROUP |
+                         PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      // The cycle counter is the group leader. The other events are optional.
+      const int group_fd = (e == cycles) ? -1 : fd[cycles];
+
+      fd[e] = syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+
+      if (fd[e] == -1)
+        {
+          if (e == cycles)
+            {
+              notice = std::string("Hardware counters are not available: "
+                                   "perf_event_open failed (") +
+                       std::strerror(errno) +
+                       "). Check /proc/sys/kernel/perf_event_paranoid and "
+                       "whether the container has access to the PMU. "
+                       "Continuing without hardware counters.";
+              return;
+            }
+
+          notice += std::string("The counter ") + get_name(Event(e)) +
+                    " is not available (" + std::strerror(errno) + "). ";
+          continue;
+        }
+
+      available[e] = true;
+      position[e]  = n_open++;
+    }
+
+  ioctl(fd[cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fd[cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+  notice = "Hardware counters are available on Linux only. "
+           "Continuing without hardware counters.";
+#endif
+}
+
+inline PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+  for (const int f : fd)
+    if (f != -1)
+      close(f);
+#endif
+}
+
+inline PerfCounters::Reading
+PerfCounters::read() const
+{
+  Reading reading;
+  reading.counts.fill(0);
+
+#ifdef __linux__
+  if (!is_available())
+    return reading;
+
+  // The layout of the buffer: nr, time_enabled, time_running, value[nr].
+  std::array<std::uint64_t, 3 + n_events> buffer;
+
+  if (::read(fd[cycles], buffer.data(), sizeof(buffer)) <
+      static_cast<ssize_t>((3 + n_open) * sizeof(std::uint64_t)))
+    return reading;
+
+  reading.time_enabled = buffer[1];
+  reading.time_running = buffer[2];
+
+  for (unsigned int e = 0; e < n_events; e++)
+    if (available[e])
+      reading.counts[e] = buffer[3 + position[e]];
+#endif
+
+  return reading;
+}
+
+inline PerfCounters::Values
+PerfCounters::difference(const Reading &start, const Reading &end)
+{
+  const std::uint64_t enabled = end.time_enabled - start.time_enabled;
+  const std::uint64_t running = end.time_running - start.time_running;
+
+  const double scale =
+    (running > 0 && running < enabled) ? double(enabled) / running : 1.0;
+
+  Values values;
+
+  // The raw counts and times are monotonic, so the differences can only be
+  // negative if the readings are swapped.
+  for (unsigned int e = 0; e < n_events; e++)
+    values[e] = (end.counts[e] > start.counts[e]) ?
+                  static_cast<std::uint64_t>(
+                    scale * (end.counts[e] - start.counts[e])) :
+                  0;
+
+  return values;
+}
+
+#endif
@@ -0,0 +1,806 @@
+/******************************************************************************
+ * Copyright (C) Siarhei Uzunbajakau, 2023.
+ *
+ * This program is free software. You can use, modify, and redistribute it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 or (at your option) any later version.
+ * This program is distributed without any warranty.
+ *
+ * Refer to COPYING.LESSER for more details.
+ ******************************************************************************/
+
+#ifndef SectionTimer_H__
+#define SectionTimer_H__
+
+// A low-overhead alternative to TimerOutput::Scope for hot loops and
+// multithreaded code.
+//
+//   STMR("Assemble: reinit");
+//
+// times the enclosing scope. The name of the section is interned into an
+// integer id that is stored in a function-local static at the call site. The
+// interning happens at run time, the first time the call site is executed
+// (a mutex and a linear search over the names). Afterwards, entering a section
+// costs only the initialization guard of the static, a load and a predictable
+// branch, and does not involve any string comparison, map lookup, or mutex.
+// Truly compile-time ids would need the set of all section names to be known
+// in one place, which is not the case for header-only scopes spread over
+// several programs. The times are accumulated in per-thread counters that are
+// merged only when the summary is printed:
+//
+//   SectionTimer::print_summary(std::cout);
+//
+// The wall and CPU times of a section are summed over all threads that entered
+// it. The CPU time is the CPU time of the calling thread.
+//
+// The scopes can be nested. After
+//
+//   SectionTimer::enable_tracing();
+//
+// every scope also records its begin and end time stamps and its nesting depth
+// into a ring buffer of the calling thread. The recorded trace can be exported
+// with write_chrome_trace() into the Chrome trace-event JSON format (open it in
+// chrome://tracing or https://ui.perfetto.dev) and with write_folded_stacks()
+// into the folded-stack format of flamegraph.pl. Recording adds one relaxed
+// atomic load when a scope is entered and one 24-byte store into the ring
+// buffer when it is left, i.e. roughly 5-10 ns per scope on top of the clock
+// reads (see the timer-overhead program of timetable). If a thread records
+// more than trace_capacity events, the oldest ones are overwritten.
+//
+// A trace buffer holds trace_capacity events of 24 bytes, i.e. 1.5 MiB. The
+// buffers are allocated and zeroed outside of any timed scope: by
+// enable_tracing() for the threads that are alive at that time and by the
+// registration of a thread (its first scope, or register_thread()) for the
+// threads started later. When a thread exits, its buffer keeps its events.
+// The buffer is handed over to a new thread only after its events have been
+// exported; until then new threads get new buffers. The number of buffers is
+// capped at max_trace_buffers, i.e. the trace takes at most 384 MiB in the
+// whole process. Once the cap is reached, a new thread takes over the buffer
+// of an exited thread even if its events have not been exported (they are
+// dropped) or, if no thread has exited, is not traced. The numbers of
+// overwritten and dropped events and of untraced threads are written into
+// both exports, so an incomplete trace can be recognized.
+//
+// Compiling with -DSECTIONTIMERS__=0 removes all STMR(...) scopes.
+//
+// Reading the wall clock goes through the vDSO and costs a few tens of ns.
+// Reading the CPU clock of a thread is a system call and costs a few hundred
+// ns. Inside per-cell loops and other short scopes use
+//
+//   STMR_WALL("Assemble: reinit");
+//
+// which reads the wall clock only and reports a zero CPU time. Compiling with
+// -DSECTIONTIMERS_CPU__=0 skips the CPU clock in all scopes.
+
+#ifndef SECTIONTIMERS__
+#  define SECTIONTIMERS__ 1
+#endif
+
+#ifndef SECTIONTIMERS_CPU__
+#  define SECTIONTIMERS_CPU__ 1
+#endif
+
+#include <time.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SectionTimer
+{
+  // The maximal number of distinct section names.
+  constexpr unsigned int max_sections = 256;
+
+  // The capacity of the trace ring buffer of every thread.
+  constexpr std::size_t trace_capacity = 1 << 16;
+
+  // The maximal number of trace buffers in the process.
+  constexpr unsigned int max_trace_buffers = 256;
+
+  inline std::uint64_t
+  now_ns(const clockid_t clock)
+  {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return std::uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+  }
+
+  template <bool with_cpu>
+  inline std::uint64_t
+  thread_cpu_ns()
+  {
+#if SECTIONTIMERS_CPU__
+    if (with_cpu)
+      return now_ns(CLOCK_THREAD_CPUTIME_ID);
+#endif
+    return 0;
+  }
+
+  // Each counter is written by its owning thread only, so relaxed loads and
+  // stores are sufficient and no read-modify-write instructions are needed.
+  // The atomics just make reads from the reporting thread well defined.
+  struct Accumulator
+  {
+    std::atomic<std::uint64_t> wall_ns{0};
+    std::atomic<std::uint64_t> cpu_ns{0};
+    std::atomic<std::uint64_t> n_calls{0};
+
+    void
+    add(const std::uint64_t wall, const std::uint64_t cpu)
+    {
+      wall_ns.store(wall_ns.load(std::memory_order_relaxed) + wall,
+                    std::memory_order_relaxed);
+      cpu_ns.store(cpu_ns.load(std::memory_order_relaxed) + cpu,
+                   std::memory_order_relaxed);
+      n_calls.store(n_calls.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    }
+  };
+
+  using Accumulators = std::array<Accumulator, max_sections>;
+
+  struct Totals
+  {
+    std::uint64_t wall_ns = 0;
+    std::uint64_t cpu_ns  = 0;
+    std::uint64_t n_calls = 0;
+  };
+
+  // A scope that has been left. The time stamps are CLOCK_MONOTONIC in ns. The
+  // depth of the outermost scope is 0.
+  struct TraceEvent
+  {
+    std::uint32_t id;
+    std::uint32_t depth;
+    std::uint64_t begin_ns;
+    std::uint64_t end_ns;
+  };
+
+  // The ring buffer of trace events of one thread. Written by the owning
+  // thread only. The events are zeroed on allocation, so the pages are
+  // resident before the first event is recorded.
+  struct TraceBuffer
+  {
+    TraceBuffer(const unsigned int thread_index)
+      : thread_index(thread_index)
+      , events(trace_capacity)
+    {}
+
+    void
+    push(const TraceEvent &event)
+    {
+      const std::uint64_t n = n_written.load(std::memory_order_relaxed);
+      events[n % trace_capacity] = event;
+      n_written.store(n + 1, std::memory_order_release);
+    }
+
+    unsigned int               thread_index;
+    std::vector<TraceEvent>    events;
+    std::atomic<std::uint64_t> n_written{0};
+
+    // The value of n_written at the last export. Protected by the mutex of
+    // the registry.
+    std::uint64_t n_exported = 0;
+
+    // The number of events that have been overwritten in the ring.
+    std::uint64_t
+    n_overwritten() const
+    {
+      const std::uint64_t n = n_written.load(std::memory_order_acquire);
+      return (n > trace_capacity) ? n - trace_capacity : 0;
+    }
+  };
+
+  // The events missing from an exported trace, counted since the start of
+  // the program.
+  struct TraceLosses
+  {
+    // Overwritten in the ring buffer of a thread that recorded more than
+    // trace_capacity events.
+    std::uint64_t n_overwritten = 0;
+
+    // Recorded by an exited thread and discarded, before they were exported,
+    // because the buffer was taken over by a new thread.
+    std::uint64_t n_dropped = 0;
+
+    // Threads that were not traced because max_trace_buffers was reached.
+    unsigned int n_untraced_threads = 0;
+  };
+
+  // The counters and the trace buffer of one thread. The trace buffer is
+  // assigned under the mutex of the registry, possibly by another thread, and
+  // is read by the owning thread without the mutex.
+  struct ThreadState
+  {
+    ThreadState(const unsigned int thread_index)
+      : thread_index(thread_index)
+    {}
+
+    Accumulators               accumulators;
+    std::atomic<TraceBuffer *> trace{nullptr};
+    const unsigned int         thread_index;
+  };
+
+  // Global state. The mutex protects the section names, the list of live
+  // threads, the totals of the threads that have exited, and the trace
+  // buffers. It is never taken on the hot path.
+  struct Registry
+  {
+    std::mutex                                mutex;
+    std::vector<std::string>                  names;
+    std::vector<std::shared_ptr<ThreadState>> threads;
+    std::array<Totals, max_sections>          retired;
+
+    // All trace buffers ever allocated, at most max_trace_buffers. The buffer
+    // of a thread that has exited keeps its events, so they can still be
+    // exported, until the buffer is handed over to a new thread.
+    std::vector<std::unique_ptr<TraceBuffer>> traces;
+    std::vector<TraceBuffer *>                free_traces;
+    std::atomic<bool>                         tracing{false};
+
+    // The losses of the buffers that have been handed over to new threads.
+    TraceLosses losses;
+    unsigned int                              n_threads = 0;
+
+    const std::uint64_t start_wall_ns = now_ns(CLOCK_MONOTONIC);
+    const std::uint64_t start_cpu_ns  = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+    static Registry &
+    get()
+    {
+      static Registry registry;
+      return registry;
+    }
+
+    // Gives the thread a trace buffer: the buffer of an exited thread whose
+    // events have all been exported if there is one, a new buffer if
+    // max_trace_buffers is not reached, and the buffer of the exited thread
+    // that has exited first otherwise. The mutex must be held.
+    void
+    assign_trace(ThreadState &thread)
+    {
+      if (thread.trace.load(std::memory_order_relaxed) != nullptr)
+        return;
+
+      TraceBuffer *buffer = nullptr;
+
+      const auto exported =
+        std::find_if(free_traces.begin(),
+                     free_traces.end(),
+                     [](const TraceBuffer *b) {
+                       return b->n_exported ==
+                              b->n_written.load(std::memory_order_relaxed);
+                     });
+
+      if (exported != free_traces.end())
+        {
+          buffer = *exported;
+          free_traces.erase(exported);
+        }
+      else if (traces.size() < max_trace_buffers)
+        {
+          traces.push_back(std::make_unique<TraceBuffer>(thread.thread_index));
+          thread.trace.store(traces.back().get(), std::memory_order_release);
+          return;
+        }
+      else if (!free_traces.empty())
+        {
+          buffer = free_traces.front();
+          free_traces.erase(free_traces.begin());
+
+          const std::uint64_t n =
+            buffer->n_written.load(std::memory_order_relaxed);
+          losses.n_dropped += std::min<std::uint64_t>(n - buffer->n_exported,
+                                                      trace_capacity);
+        }
+      else
+        {
+          losses.n_untraced_threads++;
+          return;
+        }
+
+      losses.n_overwritten += buffer->n_overwritten();
+
+      buffer->thread_index = thread.thread_index;
+      buffer->n_written.store(0, std::memory_order_relaxed);
+      buffer->n_exported = 0;
+
+      thread.trace.store(buffer, std::memory_order_release);
+    }
+  };
+
+  // Registers the thread on first use and merges its counters into the
+  // retired totals when the thread exits. If tracing is enabled, the trace
+  // buffer is assigned here, i.e. before the first scope of the thread reads
+  // the clock.
+  class ThreadData
+  {
+  public:
+    ThreadData()
+    {
+      Registry                   &registry = Registry::get();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+
+      state = std::make_shared<ThreadState>(registry.n_threads++);
+      registry.threads.push_back(state);
+
+      if (registry.tracing.load(std::memory_order_relaxed))
+        registry.assign_trace(*state);
+    }
+
+    ~ThreadData()
+    {
+      Registry                   &registry = Registry::get();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+
+      for (unsigned int id = 0; id < max_sections; id++)
+        {
+          registry.retired[id].wall_ns += state->accumulators[id].wall_ns;
+          registry.retired[id].cpu_ns += state->accumulators[id].cpu_ns;
+          registry.retired[id].n_calls += state->accumulators[id].n_calls;
+        }
+
+      if (TraceBuffer *buffer = state->trace.load(std::memory_order_relaxed))
+        registry.free_traces.push_back(buffer);
+
+      registry.threads.erase(
+        std::find(registry.threads.begin(), registry.threads.end(), state));
+    }
+
+    static ThreadData &
+    get()
+    {
+      thread_local ThreadData data;
+      return data;
+    }
+
+    Accumulator &
+    accumulator(const unsigned int id)
+    {
+      return state->accumulators[id];
+    }
+
+    // Null if the thread is not traced.
+    TraceBuffer *
+    trace()
+    {
+      return state->trace.load(std::memory_order_acquire);
+    }
+
+    // The number of scopes the thread is currently in.
+    std::uint32_t depth = 0;
+
+  private:
+    std::shared_ptr<ThreadState> state;
+  };
+
+  // Registers the calling thread. Threads are registered automatically by
+  // their first scope; calling this at the start of a thread keeps the
+  // registration out of the first timed section.
+  inline void
+  register_thread()
+  {
+    ThreadData::get();
+  }
+
+  // Returns the id of the section with the given name. The same name always
+  // gets the same id. Called once per STMR(...) call site.
+  inline unsigned int
+  section_id(const std::string &name)
+  {
+    Registry                   &registry = Registry::get();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    const auto it =
+      std::find(registry.names.begin(), registry.names.end(), name);
+
+    if (it != registry.names.end())
+      return it - registry.names.begin();
+
+    if (registry.names.size() == max_sections)
+      throw std::length_error("SectionTimer: too many sections.");
+
+    registry.names.push_back(name);
+    return registry.names.size() - 1;
+  }
+
+  // Times the enclosing scope. If with_cpu is false, the CPU clock is not
+  // read, see STMR_WALL(...).
+  template <bool with_cpu>
+  class BasicScope
+  {
+  public:
+    BasicScope(const unsigned int id)
+      : thread(ThreadData::get())
+      , id(id)
+      , traced(Registry::get().tracing.load(std::memory_order_relaxed))
+      , wall_start(now_ns(CLOCK_MONOTONIC))
+      , cpu_start(thread_cpu_ns<with_cpu>())
+    {
+      thread.depth++;
+    }
+
+    ~BasicScope()
+    {
+      const std::uint64_t cpu_end  = thread_cpu_ns<with_cpu>();
+      const std::uint64_t wall_end = now_ns(CLOCK_MONOTONIC);
+
+      thread.depth--;
+      thread.accumulator(id).add(wall_end - wall_start, cpu_end - cpu_start);
+
+      if (traced)
+        if (TraceBuffer *buffer = thread.trace())
+          buffer->push({id, thread.depth, wall_start, wall_end});
+    }
+
+    BasicScope(const BasicScope &) = delete;
+    BasicScope &
+    operator=(const BasicScope &) = delete;
+
+  private:
+    ThreadData         &thread;
+    const unsigned int  id;
+    const bool          traced;
+    const std::uint64_t wall_start;
+    const std::uint64_t cpu_start;
+  };
+
+  using Scope     = BasicScope<true>;
+  using WallScope = BasicScope<false>;
+
+  // Merges the counters of all threads.
+  inline std::vector<Totals>
+  collect()
+  {
+    Registry                   &registry = Registry::get();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::vector<Totals> totals(registry.names.size());
+
+    for (unsigned int id = 0; id < totals.size(); id++)
+      {
+        totals[id] = registry.retired[id];
+
+        for (const auto &thread : registry.threads)
+          {
+            const Accumulator &a = thread->accumulators[id];
+
+            totals[id].wall_ns += a.wall_ns.load(std::memory_order_relaxed);
+            totals[id].cpu_ns += a.cpu_ns.load(std::memory_order_relaxed);
+            totals[id].n_calls += a.n_calls.load(std::memory_order_relaxed);
+          }
+      }
+
+    return totals;
+  }
+
+  // Prints the summary in the format of
+  // TimerOutput::cpu_and_wall_times_grouped. The totals are the CPU time of
+  // the process and the wall time elapsed since the first use of the timers.
+  inline void
+  print_summary(std::ostream &out)
+  {
+    const std::vector<Totals> totals = collect();
+
+    Registry &registry = Registry::get();
+
+    std::vector<std::string> names;
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      names = registry.names;
+    }
+
+    const double total_wall =
+      1e-9 * (now_ns(CLOCK_MONOTONIC) - registry.start_wall_ns);
+    const double total_cpu =
+      1e-9 * (now_ns(CLOCK_PROCESS_CPUTIME_ID) - registry.start_cpu_ns);
+
+    auto time = [](const double t) {
+      std::ostringstream ss;
+      ss << std::setprecision(3) << t << "s";
+      return ss.str();
+    };
+
+    auto percent = [](const double t, const double total) {
+      std::ostringstream ss;
+      ss << std::fixed << std::setprecision(0)
+         << ((total > 0.0) ? 100.0 * t / total : 0.0) << "%";
+      return ss.str();
+    };
+
+    const std::string line = "+---------------------------------+-----------+"
+                             "------------+------------+------------+"
+                             "------------+\n";
+
+    out << "\n\n"
+        << "+---------------------------------------------+------------+"
+        << "------------+------------+------------+\n"
+        << "| Total CPU/wall time elapsed since start     |"
+        << std::setw(11) << time(total_cpu) << " |            |"
+        << std::setw(11) << time(total_wall) << " |            |\n"
+        << "|                                             |            |"
+        << "            |            |            |\n"
+        << "| Section                         | no. calls |  CPU time  "
+        << "| % of total |  wall time | % of total |\n"
+        << line;
+
+    for (unsigned int id = 0; id < totals.size(); id++)
+      {
+        if (totals[id].n_calls == 0)
+          continue;
+
+        const double cpu  = 1e-9 * totals[id].cpu_ns;
+        const double wall = 1e-9 * totals[id].wall_ns;
+
+        out << "| " << std::left << std::setw(32)
+            << names[id].substr(0, 31) << std::right << "| "
+            << std::setw(9) << totals[id].n_calls << " | " << std::setw(10)
+            << time(cpu) << " | " << std::setw(10) << percent(cpu, total_cpu)
+            << " | " << std::setw(10) << time(wall) << " | " << std::setw(10)
+            << percent(wall, total_wall) << " |\n";
+      }
+
+    out << line << "\n";
+  }
+
+  // Zeroes the counters of all threads. Must not be called while other threads
+  // are inside STMR(...) scopes.
+  inline void
+  reset()
+  {
+    Registry                   &registry = Registry::get();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    registry.retired.fill(Totals());
+
+    for (const auto &thread : registry.threads)
+      for (Accumulator &a : thread->accumulators)
+        {
+          a.wall_ns.store(0, std::memory_order_relaxed);
+          a.cpu_ns.store(0, std::memory_order_relaxed);
+          a.n_calls.store(0, std::memory_order_relaxed);
+        }
+  }
+
+  // Starts or stops recording the trace. Scopes that are already open when
+  // the tracing is switched on are not recorded. The trace buffers of the
+  // live threads are allocated here, the ones of the threads started later
+  // when they register.
+  inline void
+  enable_tracing(const bool enable = true)
+  {
+    Registry                   &registry = Registry::get();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    registry.tracing.store(enable, std::memory_order_relaxed);
+
+    if (enable)
+      for (const auto &thread : registry.threads)
+        registry.assign_trace(*thread);
+  }
+
+  // Copies the recorded events of every thread and marks them as exported.
+  // The events of a thread are sorted by their begin time, outer scopes before
+  // inner ones. Must not be called while other threads are inside traced
+  // scopes.
+  inline std::vector<std::pair<unsigned int, std::vector<TraceEvent>>>
+  collect_trace()
+  {
+    Registry                   &registry = Registry::get();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::vector<std::pair<unsigned int, std::vector<TraceEvent>>> traces;
+
+    for (const auto &buffer : registry.traces)
+      {
+        const std::uint64_t n =
+          buffer->n_written.load(std::memory_order_acquire);
+
+        buffer->n_exported = n;
+
+        if (n == 0)
+          continue;
+
+        const std::uint64_t first =
+          (n > trace_capacity) ? n - trace_capacity : 0;
+
+        std::vector<TraceEvent> events;
+        events.reserve(n - first);
+
+        for (std::uint64_t i = first; i < n; i++)
+          events.push_back(buffer->events[i % trace_capacity]);
+
+        std::sort(events.begin(),
+                  events.end(),
+                  [](const TraceEvent &a, const TraceEvent &b) {
+                    if (a.begin_ns != b.begin_ns)
+                      return a.begin_ns < b.begin_ns;
+                    return a.depth < b.depth;
+                  });
+
+        traces.emplace_back(buffer->thread_index, std::move(events));
+      }
+
+    return traces;
+  }
+
+  inline TraceLosses
+  trace_losses()
+  {
+    Registry                   &registry = Registry::get();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    TraceLosses losses = registry.losses;
+
+    for (const auto &buffer : registry.traces)
+      losses.n_overwritten += buffer->n_overwritten();
+
+    return losses;
+  }
+
+  inline std::string
+  escape_json(const std::string &str)
+  {
+    std::string escaped;
+    for (const char c : str)
+      {
+        if (c == '"' || c == '\\')
+          escaped += '\\';
+        escaped += c;
+      }
+    return escaped;
+  }
+
+  // Writes the trace in the Chrome trace-event format. Every scope becomes a
+  // complete ("X") event. The time stamps are in us since the first use of
+  // the timers. The losses (see TraceLosses) are written into "otherData".
+  inline void
+  write_chrome_trace(std::ostream &out)
+  {
+    const auto        traces = collect_trace();
+    const TraceLosses losses = trace_losses();
+
+    Registry &registry = Registry::get();
+
+    std::vector<std::string> names;
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      names = registry.names;
+    }
+
+    const std::streamsize precision = out.precision();
+
+    out << "{\"displayTimeUnit\": \"ms\",\n"
+        << "\"otherData\": {\"overwritten_events\": " << losses.n_overwritten
+        << ", \"dropped_events\": " << losses.n_dropped
+        << ", \"untraced_threads\": " << losses.n_untraced_threads << "},\n"
+        << "\"traceEvents\": [";
+
+    bool first = true;
+    for (const auto &trace : traces)
+      for (const TraceEvent &event : trace.second)
+        {
+          out << (first ? "\n" : ",\n") << "{\"name\": \""
+              << escape_json(names[event.id])
+              << "\", \"cat\": \"section\", \"ph\": \"X\", \"pid\": 1, "
+              << "\"tid\": " << trace.first << ", \"ts\": " << std::fixed
+              << std::setprecision(3)
+              << 1e-3 * (event.begin_ns - registry.start_wall_ns)
+              << ", \"dur\": " << 1e-3 * (event.end_ns - event.begin_ns)
+              << std::defaultfloat << "}";
+
+          first = false;
+        }
+
+    out << "\n]}\n" << std::setprecision(precision);
+  }
+
+  // Writes the trace in the folded-stack format of flamegraph.pl: one line
+  // "thread N;outer;inner self_time" per distinct stack, where self_time is
+  // the wall time in ns spent in the innermost scope outside of its children.
+  //
+  // An event is recorded when its scope is left, so a parent is always
+  // recorded after its children, and the ring buffer overwrites children
+  // before their parent. If some children of a parent have been overwritten,
+  // their time is counted as the self time of the parent. In this case, and if
+  // events were dropped or threads were not traced (see TraceLosses), the
+  // first line is a comment that ends with a word rather than a number, so
+  // flamegraph.pl skips it.
+  inline void
+  write_folded_stacks(std::ostream &out)
+  {
+    const auto        traces = collect_trace();
+    const TraceLosses losses = trace_losses();
+
+    if (losses.n_overwritten > 0 || losses.n_dropped > 0 ||
+        losses.n_untraced_threads > 0)
+      out << "# incomplete trace: " << losses.n_overwritten
+          << " events overwritten, " << losses.n_dropped
+          << " events dropped, " << losses.n_untraced_threads
+          << " threads not traced\n";
+
+    std::vector<std::string> names;
+    {
+      Registry                   &registry = Registry::get();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      names = registry.names;
+    }
+
+    std::map<std::string, std::uint64_t> folded;
+
+    for (const auto &trace : traces)
+      {
+        struct Frame
+        {
+          std::uint32_t depth;
+          std::string   path;
+          std::uint64_t self_ns;
+        };
+
+        // The stack of the scopes enclosing the current event.
+        std::vector<Frame> stack;
+
+        auto pop = [&stack, &folded]() {
+          folded[stack.back().path] += stack.back().self_ns;
+          stack.pop_back();
+        };
+
+        const std::string root = "thread " + std::to_string(trace.first);
+
+        for (const TraceEvent &event : trace.second)
+          {
+            while (!stack.empty() && stack.back().depth >= event.depth)
+              pop();
+
+            const std::uint64_t duration = event.end_ns - event.begin_ns;
+
+            if (!stack.empty())
+              stack.back().self_ns -= std::min(stack.back().self_ns, duration);
+
+            stack.push_back({event.depth,
+                             (stack.empty() ? root : stack.back().path) + ";" +
+                               names[event.id],
+                             duration});
+          }
+
+        while (!stack.empty())
+          pop();
+      }
+
+    for (const auto &f : folded)
+      out << f.first << " " << f.second << "\n";
+  }
+} // namespace SectionTimer
+
+#define STMR_CONCAT_(a, b) a##b
+#define STMR_CONCAT(a, b) STMR_CONCAT_(a, b)
+
+#if SECTIONTIMERS__
+#  define STMR_SCOPE(__type, __name)                                       \
+    static const unsigned int STMR_CONCAT(stmr_id_, __LINE__) =            \
+      SectionTimer::section_id(__name);                                    \
+    SectionTimer::__type STMR_CONCAT(stmr_scope_, __LINE__)(               \
+      STMR_CONCAT(stmr_id_, __LINE__))
+#  define STMR(__name) STMR_SCOPE(Scope, __name)
+#  define STMR_WALL(__name) STMR_SCOPE(WallScope, __name)
+#else
+#  define STMR(__name) \
+    do                 \
+      {                \
+      }                \
+    while (false)
+#  define STMR_WALL(__name) STMR(__name)
+#endif
+
+#endif
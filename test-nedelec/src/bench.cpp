@@ -0,0 +1,348 @@
+/******************************************************************************
+ * Copyright (C) Siarhei Uzunbajakau, 2023.
+ *
+ * This program is free software. You can use, modify, and redistribute it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 or (at your option) any later version.
+ * This program is distributed without any warranty.
+ *
+ * Refer to COPYING.LESSER for more details.
+ ******************************************************************************/
+
+// Microbenchmarks of the deal.II kernels that dominate the test-nedelec
+// program: FEValues::reinit, extractor-based access to the shape values,
+// AffineConstraints::distribute_local_to_global, SparseMatrix::vmult,
+// PreconditionSSOR::vmult, and VectorTools::integrate_difference. Each kernel
+// is measured in 2D and 3D for FE_Nedelec of degree 0...4 and is reported in
+// cells/s or nonzeros/s.
+//
+// Usage: bench-nedelec [harness options, see benchmark_harness.h]
+
+#define BOOST_ALLOW_DEPRECATED_HEADERS
+
+#include <deal.II/base/function.h>
+#include <deal.II/base/quadrature_lib.h>
+
+#include <deal.II/dofs/dof_handler.h>
+#include <deal.II/dofs/dof_tools.h>
+
+#include <deal.II/fe/fe_nedelec.h>
+#include <deal.II/fe/fe_values.h>
+#include <deal.II/fe/mapping_q.h>
+
+#include <deal.II/grid/grid_generator.h>
+#include <deal.II/grid/tria.h>
+
+#include <deal.II/lac/affine_constraints.h>
+#include <deal.II/lac/dynamic_sparsity_pattern.h>
+#include <deal.II/lac/full_matrix.h>
+#include <deal.II/lac/precondition.h>
+#include <deal.II/lac/sparse_matrix.h>
+#include <deal.II/lac/vector.h>
+
+#include <deal.II/numerics/vector_tools.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark_harness.h"
+
+#define TMR(__name) BenchmarkHarness::Scope timer_section(timer, __name)
+
+using namespace dealii;
+
+template <int dim>
+class NedelecKernels
+{
+public:
+  NedelecKernels() = delete;
+  NedelecKernels(unsigned int degree, BenchmarkHarness &harness);
+
+  void
+  run(BenchmarkHarness::Timer &timer);
+
+private:
+  // The number of matrix-vector products per run.
+  const unsigned int n_vmult = 10;
+
+  const std::string prefix;
+
+  Triangulation<dim> triangulation;
+  FE_Nedelec<dim>    fe;
+  MappingQ<dim>      mapping;
+  DoFHandler<dim>    dof_handler;
+  QGauss<dim>        quadrature;
+
+  SparsityPattern           sparsity_pattern;
+  AffineConstraints<double> constraints;
+
+  // Assembled once in the constructor and only read by the kernels.
+  SparseMatrix<double> system_matrix;
+  Vector<double>       system_rhs;
+
+  // Written by the distribute_local_to_global() kernel.
+  SparseMatrix<double> scratch_matrix;
+  Vector<double>       scratch_rhs;
+
+  const FEValuesExtractors::Vector VE;
+
+  FullMatrix<double> cell_matrix;
+  Vector<double>     cell_rhs;
+
+  Vector<double> solution;
+  Vector<double> tmp;
+
+  void
+  assemble(SparseMatrix<double> &matrix, Vector<double> &rhs) const;
+
+  void
+  reinit(BenchmarkHarness::Timer &timer);
+
+  void
+  shape_values(BenchmarkHarness::Timer &timer);
+
+  void
+  distribute_local_to_global(BenchmarkHarness::Timer &timer);
+
+  void
+  vmult(BenchmarkHarness::Timer &timer);
+
+  void
+  ssor(BenchmarkHarness::Timer &timer);
+
+  void
+  integrate_difference(BenchmarkHarness::Timer &timer);
+};
+
+// The meshes are chosen such that a run of all kernels takes well below a
+// second.
+template <int dim>
+NedelecKernels<dim>::NedelecKernels(unsigned int      degree,
+                                    BenchmarkHarness &harness)
+  : prefix(std::to_string(dim) + "D p" + std::to_string(degree) + ": ")
+  , fe(degree)
+  , mapping(1)
+  , dof_handler(triangulation)
+  , quadrature(degree + 2)
+  , VE(0)
+{
+  GridGenerator::hyper_cube(triangulation, -1.0, 1.0);
+
+  if (dim == 2)
+    triangulation.refine_global((degree < 2) ? 5 : 4);
+  else
+    triangulation.refine_global((degree < 2) ? 3 : 2);
+
+  dof_handler.distribute_dofs(fe);
+
+  constraints.clear();
+  DoFTools::make_hanging_node_constraints(dof_handler, constraints);
+  constraints.close();
+
+  {
+    DynamicSparsityPattern dsp(dof_handler.n_dofs(), dof_handler.n_dofs());
+    DoFTools::make_sparsity_pattern(dof_handler, dsp, constraints, false);
+    sparsity_pattern.copy_from(dsp);
+  }
+
+  system_matrix.reinit(sparsity_pattern);
+  system_rhs.reinit(dof_handler.n_dofs());
+  scratch_matrix.reinit(sparsity_pattern);
+  scratch_rhs.reinit(dof_handler.n_dofs());
+  solution.reinit(dof_handler.n_dofs());
+  tmp.reinit(dof_handler.n_dofs());
+
+  // All cells of the mesh are equal, so the mass matrix of the first cell is
+  // used as the local matrix of every cell.
+  const unsigned int dofs_per_cell = fe.n_dofs_per_cell();
+
+  cell_matrix.reinit(dofs_per_cell, dofs_per_cell);
+  cell_rhs.reinit(dofs_per_cell);
+
+  FEValues<dim> fe_values(mapping,
+                          fe,
+                          quadrature,
+                          update_values | update_JxW_values);
+  fe_values.reinit(dof_handler.begin_active());
+
+  for (const unsigned int q : fe_values.quadrature_point_indices())
+    for (const unsigned int i : fe_values.dof_indices())
+      {
+        for (const unsigned int j : fe_values.dof_indices())
+          cell_matrix(i, j) += fe_values[VE].value(i, q) *
+                               fe_values[VE].value(j, q) * fe_values.JxW(q);
+
+        cell_rhs(i) += fe_values[VE].value(i, q)[0] * fe_values.JxW(q);
+      }
+
+  // The matrix-vector products and SSOR do not depend on the order in which
+  // the kernels are run.
+  assemble(system_matrix, system_rhs);
+
+  for (unsigned int i = 0; i < solution.size(); i++)
+    solution(i) = 1.0 + 1.0 / (i + 1);
+
+  const double n_cells = triangulation.n_active_cells();
+  const double n_nonzeros =
+    static_cast<double>(sparsity_pattern.n_nonzero_elements());
+
+  harness.set_work(prefix + "reinit", n_cells, "cells");
+  harness.set_work(prefix + "shape values", n_cells, "cells");
+  harness.set_work(prefix + "distribute", n_cells, "cells");
+  harness.set_work(prefix + "vmult", n_vmult * n_nonzeros, "nonzeros");
+  harness.set_work(prefix + "SSOR", n_vmult * n_nonzeros, "nonzeros");
+  harness.set_work(prefix + "integrate_difference", n_cells, "cells");
+}
+
+template <int dim>
+void
+NedelecKernels<dim>::assemble(SparseMatrix<double> &matrix,
+                              Vector<double>       &rhs) const
+{
+  std::vector<types::global_dof_index> local_dof_indices(
+    fe.n_dofs_per_cell());
+
+  matrix = 0;
+  rhs    = 0;
+
+  for (const auto &cell : dof_handler.active_cell_iterators())
+    {
+      cell->get_dof_indices(local_dof_indices);
+      constraints.distribute_local_to_global(
+        cell_matrix, cell_rhs, local_dof_indices, matrix, rhs);
+    }
+}
+
+template <int dim>
+void
+NedelecKernels<dim>::reinit(BenchmarkHarness::Timer &timer)
+{
+  FEValues<dim> fe_values(mapping,
+                          fe,
+                          quadrature,
+                          update_values | update_quadrature_points |
+                            update_JxW_values);
+
+  TMR(prefix + "reinit");
+  for (const auto &cell : dof_handler.active_cell_iterators())
+    fe_values.reinit(cell);
+}
+
+// The shape values of a single cell are read once per cell of the mesh, so
+// the cost of FEValues::reinit is not included.
+template <int dim>
+void
+NedelecKernels<dim>::shape_values(BenchmarkHarness::Timer &timer)
+{
+  FEValues<dim> fe_values(mapping, fe, quadrature, update_values);
+  fe_values.reinit(dof_handler.begin_active());
+
+  double sum = 0.0;
+  {
+    TMR(prefix + "shape values");
+    for (unsigned int c = 0; c < triangulation.n_active_cells(); c++)
+      for (const unsigned int q : fe_values.quadrature_point_indices())
+        for (const unsigned int i : fe_values.dof_indices())
+          sum += fe_values[VE].value(i, q)[0];
+  }
+
+  // Keeps the compiler from removing the loop.
+  volatile double sink = sum;
+  (void)sink;
+}
+
+template <int dim>
+void
+NedelecKernels<dim>::distribute_local_to_global(BenchmarkHarness::Timer &timer)
+{
+  std::vector<types::global_dof_index> local_dof_indices(
+    fe.n_dofs_per_cell());
+
+  scratch_matrix = 0;
+  scratch_rhs    = 0;
+
+  TMR(prefix + "distribute");
+  for (const auto &cell : dof_handler.active_cell_iterators())
+    {
+      cell->get_dof_indices(local_dof_indices);
+      constraints.distribute_local_to_global(
+        cell_matrix, cell_rhs, local_dof_indices, scratch_matrix, scratch_rhs);
+    }
+}
+
+template <int dim>
+void
+NedelecKernels<dim>::vmult(BenchmarkHarness::Timer &timer)
+{
+  TMR(prefix + "vmult");
+  for (unsigned int i = 0; i < n_vmult; i++)
+    system_matrix.vmult(tmp, solution);
+}
+
+template <int dim>
+void
+NedelecKernels<dim>::ssor(BenchmarkHarness::Timer &timer)
+{
+  PreconditionSSOR<SparseMatrix<double>> preconditioner;
+  preconditioner.initialize(system_matrix, 1.2);
+
+  TMR(prefix + "SSOR");
+  for (unsigned int i = 0; i < n_vmult; i++)
+    preconditioner.vmult(tmp, solution);
+}
+
+template <int dim>
+void
+NedelecKernels<dim>::integrate_difference(BenchmarkHarness::Timer &timer)
+{
+  Functions::ZeroFunction<dim> zero(dim);
+  Vector<float>                error_per_cell(triangulation.n_active_cells());
+
+  TMR(prefix + "integrate_difference");
+  VectorTools::integrate_difference(mapping,
+                                    dof_handler,
+                                    solution,
+                                    zero,
+                                    error_per_cell,
+                                    QGauss<dim>(fe.degree + 3),
+                                    VectorTools::L2_norm);
+}
+
+template <int dim>
+void
+NedelecKernels<dim>::run(BenchmarkHarness::Timer &timer)
+{
+  reinit(timer);
+  shape_values(timer);
+  distribute_local_to_global(timer);
+  vmult(timer);
+  ssor(timer);
+  integrate_difference(timer);
+}
+
+int
+main(int argc, char *argv[])
+{
+  BenchmarkHarness harness(BenchmarkHarness::parse_command_line(argc, argv));
+
+  std::vector<std::unique_ptr<NedelecKernels<2>>> kernels_2d;
+  std::vector<std::unique_ptr<NedelecKernels<3>>> kernels_3d;
+
+  for (unsigned int p = 0; p < 5; p++)
+    {
+      kernels_2d.push_back(std::make_unique<NedelecKernels<2>>(p, harness));
+      kernels_3d.push_back(std::make_unique<NedelecKernels<3>>(p, harness));
+    }
+
+  harness.run([&](BenchmarkHarness::Timer &timer) {
+    for (auto &kernels : kernels_2d)
+      kernels->run(timer);
+
+    for (auto &kernels : kernels_3d)
+      kernels->run(timer);
+  });
+
+  return harness.report(std::cout);
+}
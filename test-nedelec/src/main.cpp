@@ -14,6 +14,7 @@
 #include <deal.II/base/geometry_info.h>
 #include <deal.II/base/multithread_info.h>
 #include <deal.II/base/quadrature_lib.h>
+#include <deal.II/base/utilities.h>
 
 #include <deal.II/dofs/dof_handler.h>
 #include <deal.II/dofs/dof_tools.h>
@@ -37,9 +38,21 @@
 #include <deal.II/numerics/matrix_tools.h>
 #include <deal.II/numerics/vector_tools.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <string>
+#include <utility>
+
+#include "section_timer.h"
+
+#ifndef MEMORYLOG__
+#  define MEMORYLOG__ 1
+#endif
 
 using namespace dealii;
 
@@ -101,6 +114,32 @@ private:
   const double k = 0.5 * pi;
 };
 
+// The memory consumed by the objects of TestNedelec, in bytes, and the
+// resident set size of the process, in kB, after a phase of the computation.
+// VmHWM is the peak resident set size during the phase if the peak could be
+// reset before the phase (phase_peak is true) and the peak resident set size
+// of the process so far otherwise.
+struct MemoryRecord
+{
+  std::string                        phase;
+  std::map<std::string, std::size_t> objects;
+  unsigned long int                  VmRSS;
+  unsigned long int                  VmHWM;
+  bool                               phase_peak;
+
+  std::size_t
+  total() const
+  {
+    std::size_t t = 0;
+    for (const auto &object : objects)
+      t += object.second;
+    return t;
+  }
+};
+
+void
+print_memory_log(std::ostream &out, const std::vector<MemoryRecord> &log);
+
 template <int dim>
 class TestNedelec
 {
@@ -129,6 +168,12 @@ public:
     return L2_norm;
   }
 
+  const std::vector<MemoryRecord> &
+  get_memory_log() const
+  {
+    return memory_log;
+  }
+
 private:
   double        L2_norm;
   Vector<float> L2_per_cell;
@@ -136,8 +181,6 @@ private:
   const unsigned int combined_face_orientation = FACEORIENTATION__;
   const unsigned int number_of_mesh_refinements;
 
-  Triangulation<dim> triangulation_right;
-  Triangulation<dim> triangulation_left;
   Triangulation<dim> triangulation;
 
   FE_Nedelec<dim>              fe;
@@ -156,6 +199,17 @@ private:
 
   const std::string fname_vtk = "Data/projection";
 
+  std::vector<MemoryRecord> memory_log;
+
+  // True if the peak resident set size has been reset before the current
+  // phase.
+  bool peak_reset = false;
+
+  // The memory consumed by the objects that exist only inside the current
+  // phase, such as the dynamic sparsity pattern and the DataOut patches.
+  // Filled by the phases, recorded and cleared by run_phase().
+  std::map<std::string, std::size_t> transient_memory;
+
   void
   make_mesh();
 
@@ -172,7 +226,16 @@ private:
   compute_error_norms();
 
   void
-  save() const;
+  save();
+
+  void
+  run_phase(const std::string &name, const std::function<void()> &phase);
+
+  void
+  reset_peak_rss();
+
+  void
+  record_memory(const std::string &phase);
 };
 
 #pragma GCC diagnostic push
@@ -328,10 +391,17 @@ TestNedelec<dim>::setup_system()
   DoFTools::make_hanging_node_constraints(dof_handler, constraints);
   constraints.close();
 
-  DynamicSparsityPattern dsp(dof_handler.n_dofs(), dof_handler.n_dofs());
-  DoFTools::make_sparsity_pattern(dof_handler, dsp, constraints, false);
+  // The dynamic sparsity pattern is released before the matrix is allocated,
+  // so the two never exist at the same time.
+  {
+    DynamicSparsityPattern dsp(dof_handler.n_dofs(), dof_handler.n_dofs());
+    DoFTools::make_sparsity_pattern(dof_handler, dsp, constraints, false);
+
+    sparsity_pattern.copy_from(dsp);
+
+    transient_memory["dynamic sparsity"] = dsp.memory_consumption();
+  }
 
-  sparsity_pattern.copy_from(dsp);
   system_matrix.reinit(sparsity_pattern);
   solution.reinit(dof_handler.n_dofs());
   system_rhs.reinit(dof_handler.n_dofs());
@@ -360,7 +430,10 @@ TestNedelec<dim>::assemble_system()
 
   for (const auto &cell : dof_handler.active_cell_iterators())
     {
-      fe_values.reinit(cell);
+      {
+        STMR_WALL("Assemble: reinit");
+        fe_values.reinit(cell);
+      }
 
       magnetic_vector_potential.vector_value_list(
         fe_values.get_quadrature_points(), exact_solution_values);
@@ -368,23 +441,27 @@ TestNedelec<dim>::assemble_system()
       cell_matrix = 0;
       cell_rhs    = 0;
 
-      for (const unsigned int q_index : fe_values.quadrature_point_indices())
-        {
-          for (const unsigned int i : fe_values.dof_indices())
-            {
-              for (const unsigned int j : fe_values.dof_indices())
-                cell_matrix(i, j) += fe_values[VE].value(i, q_index) *
-                                     fe_values[VE].value(j, q_index) *
-                                     fe_values.JxW(q_index);
-
-              for (unsigned int k = 0; k < dim; k++)
-                cell_rhs(i) += fe_values[VE].value(i, q_index)[k] *
-                               exact_solution_values.at(q_index)[k] *
-                               fe_values.JxW(q_index);
-            }
-        }
+      {
+        STMR_WALL("Assemble: local");
+        for (const unsigned int q_index : fe_values.quadrature_point_indices())
+          {
+            for (const unsigned int i : fe_values.dof_indices())
+              {
+                for (const unsigned int j : fe_values.dof_indices())
+                  cell_matrix(i, j) += fe_values[VE].value(i, q_index) *
+                                       fe_values[VE].value(j, q_index) *
+                                       fe_values.JxW(q_index);
+
+                for (unsigned int k = 0; k < dim; k++)
+                  cell_rhs(i) += fe_values[VE].value(i, q_index)[k] *
+                                 exact_solution_values.at(q_index)[k] *
+                                 fe_values.JxW(q_index);
+              }
+          }
+      }
       cell->get_dof_indices(local_dof_indices);
 
+      STMR_WALL("Assemble: distribute");
       constraints.distribute_local_to_global(
         cell_matrix, cell_rhs, local_dof_indices, system_matrix, system_rhs);
     }
@@ -409,7 +486,7 @@ TestNedelec<dim>::solve()
 
 template <int dim>
 void
-TestNedelec<dim>::save() const
+TestNedelec<dim>::save()
 {
   std::vector<std::string> solution_names(dim, "MagneticVectorPotential");
   std::vector<DataComponentInterpretation::DataComponentInterpretation>
@@ -425,6 +502,8 @@ TestNedelec<dim>::save() const
 
   data_out.build_patches(fe.degree + 2);
 
+  transient_memory["DataOut patches"] = data_out.memory_consumption();
+
   std::ofstream out(fname_vtk + std::to_string(DIMENSION__) + "D_p" +
                     std::to_string(fe.degree - 1) + "_r " +
                     std::to_string(number_of_mesh_refinements) + ".vtk");
@@ -460,23 +539,256 @@ template <int dim>
 void
 TestNedelec<dim>::run()
 {
-  make_mesh();
-  setup_system();
-  assemble_system();
-  solve();
-  compute_error_norms();
-  save();
+  run_phase("Make mesh", [this]() { make_mesh(); });
+  run_phase("Setup", [this]() { setup_system(); });
+  run_phase("Assemble", [this]() { assemble_system(); });
+  run_phase("Solve", [this]() { solve(); });
+  run_phase("Error norms", [this]() { compute_error_norms(); });
+  run_phase("Save", [this]() { save(); });
+}
+
+// Times a phase of the computation and records the memory after it. The
+// section timer is looked up by name, as STMR(...) can intern only one name
+// per call site.
+template <int dim>
+void
+TestNedelec<dim>::run_phase(const std::string           &name,
+                            const std::function<void()> &phase)
+{
+  reset_peak_rss();
+  transient_memory.clear();
+  {
+#if SECTIONTIMERS__
+    SectionTimer::Scope timer_section(SectionTimer::section_id(name));
+#endif
+    phase();
+  }
+  record_memory(name);
+}
+
+// Resets the peak resident set size (VmHWM) of the process to the current
+// resident set size, so that the next record reports the peak of a single
+// phase. Requires Linux 4.0 or newer. If the reset fails, the records report
+// the peak of the process so far.
+template <int dim>
+void
+TestNedelec<dim>::reset_peak_rss()
+{
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5" << std::flush;
+  peak_reset = static_cast<bool>(clear_refs);
+}
+
+// Records the memory consumed by the persistent objects and by the transient
+// objects of the phase.
+template <int dim>
+void
+TestNedelec<dim>::record_memory(const std::string &phase)
+{
+  MemoryRecord record;
+
+  record.phase = phase;
+
+  record.objects["triangulation"] = triangulation.memory_consumption();
+  record.objects["dof handler"]   = dof_handler.memory_consumption();
+  record.objects["constraints"]   = constraints.memory_consumption();
+  record.objects["sparsity"]      = sparsity_pattern.memory_consumption();
+  record.objects["matrix"]        = system_matrix.memory_consumption();
+  record.objects["vectors"]       = solution.memory_consumption() +
+                              system_rhs.memory_consumption() +
+                              L2_per_cell.memory_consumption();
+
+  for (const auto &object : transient_memory)
+    record.objects[object.first] = object.second;
+
+  Utilities::System::MemoryStats stats;
+  Utilities::System::get_memory_stats(stats);
+
+  record.VmRSS      = stats.VmRSS;
+  record.VmHWM      = stats.VmHWM;
+  record.phase_peak = peak_reset;
+
+  memory_log.push_back(record);
+}
+
+// Prints one row per phase. The objects are in MB, the total is the sum of
+// the objects, RSS is the current resident set size of the process. The
+// last column is the peak resident set size during the phase or, if it could
+// not be reset between the phases, the peak of the process so far.
+void
+print_memory_log(std::ostream &out, const std::vector<MemoryRecord> &log)
+{
+  const bool phase_peak =
+    std::all_of(log.begin(), log.end(), [](const MemoryRecord &record) {
+      return record.phase_peak;
+    });
+
+  const std::vector<std::pair<std::string, std::string>> columns = {
+    {"triangulation", "tria"},
+    {"dof handler", "dofs"},
+    {"constraints", "constr"},
+    {"dynamic sparsity", "dsp"},
+    {"sparsity", "sp"},
+    {"matrix", "matrix"},
+    {"vectors", "vectors"},
+    {"DataOut patches", "patches"}};
+
+  out << std::left << std::setw(12) << "phase" << std::right;
+  for (const auto &c : columns)
+    out << std::setw(9) << c.second;
+  out << std::setw(9) << "total" << std::setw(9) << "RSS" << std::setw(12)
+      << (phase_peak ? "phase peak" : "total peak") << "  [MB]\n";
+
+  out << std::fixed << std::setprecision(1);
+
+  for (const MemoryRecord &record : log)
+    {
+      out << std::left << std::setw(12) << record.phase << std::right;
+
+      for (const auto &c : columns)
+        {
+          const auto it = record.objects.find(c.first);
+          out << std::setw(9);
+          if (it == record.objects.end())
+            out << "-";
+          else
+            out << it->second / 1048576.0;
+        }
+
+      out << std::setw(9) << record.total() / 1048576.0 << std::setw(9)
+          << record.VmRSS / 1024.0 << std::setw(12) << record.VmHWM / 1024.0
+          << "\n";
+    }
+
+  if (!phase_peak)
+    out << "The peak RSS could not be reset between the phases. The total "
+           "peak is the peak of the process so far.\n";
+
+  out << std::defaultfloat << std::endl;
+}
+
+// Raises the number of mesh refinements until the memory budget would be
+// exceeded and reports the memory per phase, DoFs/GB, and the peak RSS for
+// every refinement. A refinement multiplies the number of cells by 2^dim. So,
+// the next refinement is started only if 2^dim times the current peak RSS
+// fits into the budget.
+int
+scaling_study(const double budget_gb, const unsigned int p)
+{
+  const double budget_kb = budget_gb * 1024.0 * 1024.0;
+
+  std::cout << "Dimensions: " << DIMENSION__ << std::endl
+            << "Face orientation: " << FACEORIENTATION__ << std::endl
+            << "FE degree: " << p << std::endl
+            << "Memory budget: " << budget_gb << " GB" << std::endl
+            << std::endl;
+
+  struct Row
+  {
+    unsigned int      r;
+    unsigned int      n_cells;
+    unsigned int      n_dofs;
+    std::size_t       accounted;
+    unsigned long int peak_rss;
+  };
+
+  std::vector<Row> rows;
+
+  for (unsigned int r = 0;; r++)
+    {
+      std::cout << "r = " << r << " ----------------------------------------"
+                << std::endl;
+
+      TestNedelec<DIMENSION__> test(p, r);
+      test.run();
+
+      Row row;
+
+      row.r         = r;
+      row.n_cells   = test.get_n_cells();
+      row.n_dofs    = test.get_n_dofs();
+      row.accounted = 0;
+      row.peak_rss  = 0;
+
+      for (const MemoryRecord &record : test.get_memory_log())
+        {
+          row.accounted = std::max(row.accounted, record.total());
+          row.peak_rss  = std::max(row.peak_rss, record.VmHWM);
+        }
+
+      rows.push_back(row);
+
+      std::cout << "ncells = " << row.n_cells << ", ndofs = " << row.n_dofs
+                << std::endl;
+      print_memory_log(std::cout, test.get_memory_log());
+
+      if ((1 << DIMENSION__) * static_cast<double>(row.peak_rss) > budget_kb)
+        break;
+    }
+
+  std::cout << "Summary --------------------------------------------"
+            << std::endl
+            << std::setw(3) << "r" << std::setw(10) << "ncells" << std::setw(11)
+            << "ndofs" << std::setw(12) << "objects MB" << std::setw(13)
+            << "peak RSS MB" << std::setw(16) << "DoFs/GB objects"
+            << std::setw(13) << "DoFs/GB RSS" << std::endl;
+
+  for (const Row &row : rows)
+    std::cout << std::setw(3) << row.r << std::setw(10) << row.n_cells
+              << std::setw(11) << row.n_dofs << std::fixed
+              << std::setprecision(1) << std::setw(12)
+              << row.accounted / 1048576.0 << std::setw(13)
+              << row.peak_rss / 1024.0 << std::scientific
+              << std::setprecision(2) << std::setw(16)
+              << row.n_dofs / (row.accounted / 1073741824.0) << std::setw(13)
+              << row.n_dofs / (row.peak_rss / 1048576.0) << std::defaultfloat
+              << std::endl;
+
+  return 0;
 }
 
 int
-main()
+main(int argc, char *argv[])
 {
+  if (argc > 1)
+    {
+      char *end_budget = nullptr;
+      char *end_p      = nullptr;
+
+      const double budget_gb = (argc > 2) ? std::strtod(argv[2], &end_budget) :
+                                            0.0;
+      const long   p = (argc > 3) ? std::strtol(argv[3], &end_p, 10) : 0;
+
+      const bool valid = (std::string(argv[1]) == "scaling") && (argc > 2) &&
+                         (argc < 5) && (*end_budget == '\0') &&
+                         (budget_gb > 0.0) &&
+                         ((argc < 4) || (*end_p == '\0' && p >= 0 && p < 5));
+
+      if (!valid)
+        {
+          std::cout << "Usage: test-nedelec [scaling budget_GB [p]]\n"
+                    << "  budget_GB > 0, p = 0, 1, 2, 3, or 4 (0 by default)"
+                    << std::endl;
+          return 1;
+        }
+
+      return scaling_study(budget_gb, p);
+    }
+
+#if SECTIONTIMERS__ && SECTIONTRACE__
+  SectionTimer::enable_tracing();
+#endif
+
   std::cout << "Dimensions: " << DIMENSION__ << std::endl
             << "Face orientation: " << FACEORIENTATION__ << std::endl
             << "FE degree: ";
 
   std::vector<MainOutputTable> tables(5, MainOutputTable(DIMENSION__));
 
+#if MEMORYLOG__
+  std::vector<std::pair<std::string, std::vector<MemoryRecord>>> memory_logs;
+#endif
+
   for (unsigned int p = 0; p < 5; p++)
     {
       std::cout << p << " ";
@@ -537,6 +849,14 @@ main()
           tables.at(p).add_value("ndofs", test.get_n_dofs());
           tables.at(p).add_value("ncells", test.get_n_cells());
           tables.at(p).add_value("L2", test.get_L2_norm());
+
+#if MEMORYLOG__
+          memory_logs.emplace_back("p = " + std::to_string(p) +
+                                     ", r = " + std::to_string(r + r0) +
+                                     ", ndofs = " +
+                                     std::to_string(test.get_n_dofs()),
+                                   test.get_memory_log());
+#endif
         }
     }
 
@@ -545,5 +865,29 @@ main()
   for (unsigned int p = 0; p < 5; p++)
     tables.at(p).save("Data/main_table_p" + std::to_string(p));
 
+#if MEMORYLOG__
+  std::cout << std::endl;
+  for (const auto &memory_log : memory_logs)
+    {
+      std::cout << "Memory, " << memory_log.first << std::endl;
+      print_memory_log(std::cout, memory_log.second);
+    }
+#endif
+
+#if SECTIONTIMERS__
+  SectionTimer::print_summary(std::cout);
+#endif
+
+#if SECTIONTIMERS__ && SECTIONTRACE__
+  {
+    std::ofstream ofs("Data/trace.json");
+    SectionTimer::write_chrome_trace(ofs);
+  }
+  {
+    std::ofstream ofs("Data/trace.folded");
+    SectionTimer::write_folded_stacks(ofs);
+  }
+#endif
+
   return 0;
 }
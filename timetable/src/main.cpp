@@ -10,39 +10,60 @@
 ******************************************************************************/
 
 // Tests the time tables.
+//
+// Usage: timetable [--warmup N] [--repeat N] [--csv FILE] [--json FILE]
+//                  [--baseline FILE] [--threshold X] [--counters 0|1]
+//
+// Every TMR(...) section is run N times after the warmup runs. The summary
+// lists min/median/p95/stddev of the wall and CPU times of every section. If
+// a baseline csv file from a previous run is given, the program prints the
+// number of sections whose median wall time regressed by more than the
+// threshold (0.1 = 10% by default) and exits with 1 if there are any. With
+// --counters 1 the summary and the exported files also contain the medians
+// of the hardware counters (cycles, instructions, IPC, LLC misses, branch
+// misses) of every section.
+//
+// With --trace FILE and --folded FILE the nested sections (STMR(...) inside
+// TMR(...)) of all runs are exported into the Chrome trace-event format and
+// into the folded-stack format of flamegraph.pl.
 
 #define BOOST_ALLOW_DEPRECATED_HEADERS
 
 #include <deal.II/base/timer.h>
 
+#include "benchmark_harness.h"
+#include "section_timer.h"
+
 #define TMR(__name) \
-	TimerOutput::Scope timer_section(timer, __name)
+	BenchmarkHarness::Scope timer_section(timer, __name)
 
 using namespace dealii;
 
 void test()
 {
-	double d = 0.0;
+	// volatile keeps the compiler from removing the loop in Release builds.
+	volatile double d = 0.0;
 	for (unsigned int i = 0; i < 200000; i++)
 		d = i*i + d;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+	BenchmarkHarness harness(BenchmarkHarness::parse_command_line(argc, argv));
 
-	TimerOutput::OutputFrequency tf = TimerOutput::summary;
-
-	TimerOutput timer(
-		std::cout,
-		tf,
-		TimerOutput::cpu_and_wall_times_grouped);
+	harness.run([](BenchmarkHarness::Timer &timer)
+	{
+		{TMR("Make mesh"); test();}
+		{TMR("Fill Dirichlet stack"); test();}
+		{TMR("Setup"); test();}
+		{TMR("Assemble");
+			{STMR("Assemble: reinit"); test();}
+			{STMR("Assemble: distribute"); test();}
+		}
+		{TMR("Solve"); test();}
+	});
 
-	{TMR("Make mesh"); test();}
-	{TMR("Fill Dirichlet stack"); test();}
-	{TMR("Setup"); test();}
-	{TMR("Assemble"); test();}
-	{TMR("Solve"); test();}
+	SectionTimer::print_summary(std::cout);
 
-return 0;
+return harness.report(std::cout);
 }
-
@@ -0,0 +1,157 @@
+/******************************************************************************
+* Copyright (C) Siarhei Uzunbajakau, 2023.
+*
+* This program is free software. You can use, modify, and redistribute it under
+* the terms of the GNU Lesser General Public License as published by the Free
+* Software Foundation, either version 3 or (at your option) any later version.
+* This program is distributed without any warranty.
+*
+* Refer to COPYING.LESSER for more details.
+******************************************************************************/
+
+// Measures the cost of entering and leaving an empty timed scope with
+// TimerOutput::Scope, with STMR_WALL(...), which reads the wall clock only,
+// and with STMR(...), without and with tracing, at 1...N threads.
+//
+// Usage: timer-overhead [max_threads [scopes_per_thread]]
+
+#define BOOST_ALLOW_DEPRECATED_HEADERS
+
+#include <deal.II/base/exceptions.h>
+#include <deal.II/base/timer.h>
+
+#include "section_timer.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dealii;
+
+// Runs f(thread_index) on n_threads threads and returns the average wall time
+// of one iteration, in ns, over all threads.
+double measure(unsigned int n_threads, unsigned int n_iterations,
+	const std::function<void(unsigned int)> &f)
+{
+	std::vector<double> seconds(n_threads);
+	std::vector<std::thread> threads;
+
+	for (unsigned int t = 0; t < n_threads; t++)
+		threads.emplace_back([&seconds, &f, t]()
+		{
+			// Keeps the registration of the thread, and the allocation of its
+			// trace buffer, out of the measurement.
+			SectionTimer::register_thread();
+
+			const auto start = std::chrono::steady_clock::now();
+			f(t);
+			const auto end = std::chrono::steady_clock::now();
+
+			seconds[t] = std::chrono::duration<double>(end - start).count();
+		});
+
+	for (auto &thread : threads)
+		thread.join();
+
+	double total = 0.0;
+	for (double s : seconds)
+		total += s;
+
+	return 1e9 * total / (double(n_threads) * n_iterations);
+}
+
+// Parses a positive integer argument. Throws ExcMessage naming the argument
+// if it is not one.
+unsigned int parse_positive(const char *arg, const std::string &name)
+{
+	char *end;
+	const long n = std::strtol(arg, &end, 10);
+
+	AssertThrow(end != arg && *end == '\0' && n > 0 &&
+		n <= std::numeric_limits<int>::max(),
+		ExcMessage(name + " must be a positive integer, not " +
+			std::string(arg) + "."));
+
+	return n;
+}
+
+int main(int argc, char *argv[])
+{
+	const unsigned int max_threads = (argc > 1) ?
+		parse_positive(argv[1], "max_threads") :
+		std::max(1u, std::thread::hardware_concurrency());
+
+	const unsigned int n_iterations = (argc > 2) ?
+		parse_positive(argv[2], "scopes_per_thread") : 100000;
+
+	// TimerOutput does not allow two threads to be in the same section at the
+	// same time, so every thread gets its own section name.
+	std::vector<std::string> names;
+	for (unsigned int t = 0; t < max_threads; t++)
+		names.push_back("Thread " + std::to_string(t));
+
+	std::cout << "Cost of an empty timed scope, ns per scope and thread ("
+		<< n_iterations << " scopes per thread)\n\n"
+		<< "threads   TimerOutput::Scope   STMR_WALL        STMR  STMR+trace\n";
+
+	for (unsigned int n_threads = 1; n_threads <= max_threads; n_threads++)
+	{
+		TimerOutput timer(std::cout, TimerOutput::never,
+			TimerOutput::cpu_and_wall_times);
+
+		const double t_timer_output = measure(n_threads, n_iterations,
+			[&](unsigned int t)
+			{
+				for (unsigned int i = 0; i < n_iterations; i++)
+					TimerOutput::Scope timer_section(timer, names[t]);
+			});
+
+		const double t_stmr_wall = measure(n_threads, n_iterations,
+			[&](unsigned int)
+			{
+				for (unsigned int i = 0; i < n_iterations; i++)
+				{
+					STMR_WALL("Overhead, wall clock");
+				}
+			});
+
+		const double t_stmr = measure(n_threads, n_iterations,
+			[&](unsigned int)
+			{
+				for (unsigned int i = 0; i < n_iterations; i++)
+				{
+					STMR("Overhead");
+				}
+			});
+
+		SectionTimer::enable_tracing();
+
+		const double t_trace = measure(n_threads, n_iterations,
+			[&](unsigned int)
+			{
+				for (unsigned int i = 0; i < n_iterations; i++)
+				{
+					STMR("Overhead, traced");
+				}
+			});
+
+		SectionTimer::enable_tracing(false);
+
+		std::cout << std::setw(7) << n_threads
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(21) << t_timer_output
+			<< std::setw(12) << t_stmr_wall
+			<< std::setw(12) << t_stmr
+			<< std::setw(12) << t_trace << std::endl;
+	}
+
+	SectionTimer::print_summary(std::cout);
+
+return 0;
+}